@@ -0,0 +1,290 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include <deflect/Segment.h>
+#include <deflect/Stream.h>
+#include <deflect/server/Frame.h>
+#include <deflect/server/FrameArchive.h>
+#include <deflect/version.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+enum class Timing
+{
+    original,
+    fixed_rate,
+    fast
+};
+
+struct Options
+{
+    QString host;
+    QString streamName;
+    QString recordedStream;
+    Timing timing = Timing::original;
+    double fps = 0.0;
+    size_t loops = 1;
+};
+
+deflect::Segments _makeSegments(const deflect::server::Frame& frame)
+{
+    // Frames of bottom-up streams are recorded with the tile positions
+    // mirrored by the Server; restore the positions sent by the client.
+    const auto sizes = frame.computeChannelDimensions();
+
+    deflect::Segments segments;
+    segments.reserve(frame.tiles.size());
+    for (const auto& tile : frame.tiles)
+    {
+        deflect::Segment segment;
+        segment.parameters.x = tile.x;
+        segment.parameters.y = tile.y;
+        if (tile.rowOrder == deflect::RowOrder::bottom_up)
+        {
+            const auto height = sizes.at(tile.channel).height();
+            segment.parameters.y = height - tile.y - tile.height;
+        }
+        segment.parameters.width = tile.width;
+        segment.parameters.height = tile.height;
+        segment.parameters.format = tile.format;
+        segment.imageData = tile.imageData;
+        segment.view = tile.view;
+        segment.rowOrder = tile.rowOrder;
+        segment.channel = tile.channel;
+        segments.push_back(std::move(segment));
+    }
+    return segments;
+}
+
+std::vector<size_t> _selectFrames(const deflect::server::FrameArchive& archive,
+                                  QString& uri)
+{
+    std::vector<size_t> frames;
+    for (size_t i = 0; i < archive.getFrameCount(); ++i)
+    {
+        const auto frameUri = archive.getUri(i);
+        if (uri.isEmpty())
+            uri = frameUri;
+        if (frameUri == uri)
+            frames.push_back(i);
+    }
+    return frames;
+}
+
+bool _play(const deflect::server::FrameArchive& archive,
+           const std::vector<size_t>& frames, const Options& options,
+           const std::string& streamName)
+{
+    deflect::Stream stream(streamName, options.host.toStdString());
+    if (!stream.isConnected())
+    {
+        std::cerr << streamName << ": could not connect to "
+                  << options.host.toStdString() << std::endl;
+        return false;
+    }
+
+    const auto firstTimestamp = archive.getTimestamp(frames.front());
+    for (size_t loop = 0; loop < options.loops; ++loop)
+    {
+        const auto start = Clock::now();
+        for (size_t i = 0; i < frames.size(); ++i)
+        {
+            if (options.timing == Timing::original)
+            {
+                const auto offset =
+                    archive.getTimestamp(frames[i]) - firstTimestamp;
+                std::this_thread::sleep_until(
+                    start + std::chrono::microseconds(offset));
+            }
+            else if (options.timing == Timing::fixed_rate)
+            {
+                const std::chrono::duration<double> offset(i / options.fps);
+                std::this_thread::sleep_until(
+                    start +
+                    std::chrono::duration_cast<Clock::duration>(offset));
+            }
+
+            const auto frame = archive.getFrame(frames[i]);
+            for (const auto& segment : _makeSegments(*frame))
+                stream.sendSegment(segment);
+            if (!stream.finishFrame().get())
+            {
+                std::cerr << streamName << ": stream closed" << std::endl;
+                return false;
+            }
+        }
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        std::cout << streamName << ": " << frames.size() << " frames in "
+                  << elapsed.count() << " s ("
+                  << frames.size() / elapsed.count() << " fps)" << std::endl;
+    }
+    return true;
+}
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(
+        QString::fromStdString(deflect::Version::getString()));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Replay a stream recorded by a deflect::server::Server");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("archive", "Recorded stream archive");
+
+    QCommandLineOption hostOption("host", "Stream target host "
+                                          "(default: localhost)",
+                                  "host", "localhost");
+    parser.addOption(hostOption);
+
+    // note: the 'name' command line option is already taken by QCoreApplication
+    QCommandLineOption streamNameOption("streamname",
+                                        "Stream name (default: the recorded "
+                                        "stream name)",
+                                        "name");
+    parser.addOption(streamNameOption);
+
+    QCommandLineOption recordedStreamOption(
+        "recorded-stream",
+        "Recorded stream to replay if the archive has several (default: the "
+        "first one)",
+        "name");
+    parser.addOption(recordedStreamOption);
+
+    QCommandLineOption fpsOption("fps",
+                                 "Replay at a fixed frame rate instead of "
+                                 "the recorded timing",
+                                 "fps");
+    parser.addOption(fpsOption);
+
+    QCommandLineOption fastOption("fast", "Replay as fast as possible");
+    parser.addOption(fastOption);
+
+    QCommandLineOption copiesOption("copies",
+                                    "Number of concurrent streams, named "
+                                    "<name>-<index> (default: 1)",
+                                    "count", "1");
+    parser.addOption(copiesOption);
+
+    QCommandLineOption loopsOption("loops",
+                                   "Number of times to replay the archive "
+                                   "(default: 1)",
+                                   "count", "1");
+    parser.addOption(loopsOption);
+
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(EXIT_FAILURE);
+
+    Options options;
+    options.host = parser.value(hostOption);
+    options.recordedStream = parser.value(recordedStreamOption);
+    options.loops = parser.value(loopsOption).toUInt();
+    if (parser.isSet(fastOption))
+        options.timing = Timing::fast;
+    else if (parser.isSet(fpsOption))
+    {
+        options.timing = Timing::fixed_rate;
+        options.fps = parser.value(fpsOption).toDouble();
+        if (options.fps <= 0.0)
+        {
+            std::cerr << "invalid frame rate" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    const auto copies = parser.value(copiesOption).toUInt();
+
+    try
+    {
+        const deflect::server::FrameArchive archive(
+            parser.positionalArguments().at(0));
+
+        auto recordedStream = options.recordedStream;
+        const auto frames = _selectFrames(archive, recordedStream);
+        if (frames.empty())
+        {
+            std::cerr << "no frames to replay" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        auto name = parser.value(streamNameOption);
+        if (name.isEmpty())
+            name = recordedStream;
+
+        std::vector<std::thread> players;
+        std::vector<char> results(copies, false);
+        for (size_t i = 0; i < copies; ++i)
+        {
+            const auto streamName =
+                copies > 1 ? QString("%1-%2").arg(name).arg(i + 1) : name;
+            players.emplace_back([&, i, streamName] {
+                results[i] =
+                    _play(archive, frames, options, streamName.toStdString());
+            });
+        }
+        for (auto& player : players)
+            player.join();
+
+        for (const auto result : results)
+        {
+            if (!result)
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    catch (const std::runtime_error& exception)
+    {
+        std::cerr << "StreamPlayer failed: " << exception.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
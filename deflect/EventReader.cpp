@@ -0,0 +1,126 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "EventReader.h"
+
+#include "Observer.h"
+#include "Socket.h"
+
+#include <QSocketNotifier>
+
+#include <memory>
+
+namespace deflect
+{
+EventReader::EventReader(Observer& observer, Socket& socket,
+                         Callback callback)
+    : _observer(observer)
+    , _socket(socket)
+    , _callback(std::move(callback))
+{
+    start();
+}
+
+EventReader::~EventReader()
+{
+    quit();
+    wait();
+}
+
+void EventReader::run()
+{
+    // The data received while the send thread uses the socket does not
+    // activate the notifier, it is queued by the socket instead.
+    QObject context;
+    QObject::connect(&_socket, &Socket::messagesReceived, &context,
+                     [this] { _deliverEvents(); }, Qt::QueuedConnection);
+
+    // Never wait for the send thread to release the socket. The notifier is
+    // disabled meanwhile, as the pending data would keep activating it.
+    std::unique_ptr<QSocketNotifier> notifier;
+    QObject::connect(&_socket, &Socket::readyToReceive, &context,
+                     [this, &notifier] {
+                         if (notifier && !_disconnected)
+                             notifier->setEnabled(true);
+                         _deliverEvents();
+                     },
+                     Qt::QueuedConnection);
+
+    const auto watchSocket = [this, &notifier] {
+        if (notifier)
+            return;
+        notifier.reset(new QSocketNotifier(_socket.getFileDescriptor(),
+                                           QSocketNotifier::Read));
+        QObject::connect(notifier.get(), &QSocketNotifier::activated, [&] {
+            if (!_socket.tryReceiveAvailableMessages())
+                notifier->setEnabled(false); // until readyToReceive()
+            _deliverEvents();
+            if (_disconnected)
+                notifier->setEnabled(false);
+        });
+        _deliverEvents();
+    };
+
+    // A stream connecting asynchronously has no descriptor to watch yet
+    QObject::connect(&_socket, &Socket::connected, &context, watchSocket,
+                     Qt::QueuedConnection);
+    if (_socket.isConnected())
+        watchSocket();
+
+    exec();
+}
+
+void EventReader::_deliverEvents()
+{
+    while (_observer.hasEvent())
+    {
+        const auto event = _observer.getEvent();
+        if (event.type != Event::EVT_NONE)
+            _callback(event);
+    }
+
+    if (!_disconnected && !_observer.isConnected())
+    {
+        _disconnected = true;
+        Event closeEvent;
+        closeEvent.type = Event::EVT_CLOSE;
+        _callback(closeEvent);
+    }
+}
+}
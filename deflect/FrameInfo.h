@@ -0,0 +1,84 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_FRAMEINFO_H
+#define DEFLECT_FRAMEINFO_H
+
+#include <chrono>
+#include <cstdint>
+
+namespace deflect
+{
+/**
+ * Identity of a frame, sent with MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME since
+ * network protocol version 9 to allow end-to-end latency measurements.
+ */
+struct FrameInfo
+{
+    /** Sequence number of the frame for the stream, starting at 1. */
+    uint64_t frameNumber = 0;
+
+    /** Sender time when the frame started, see currentTimestamp(). */
+    int64_t timestamp = 0;
+};
+
+/**
+ * Timestamps of a clock synchronization round trip, sent by the server with
+ * MESSAGE_TYPE_CLOCK_PING and answered by the client with
+ * MESSAGE_TYPE_CLOCK_PONG since network protocol version 13.
+ */
+struct ClockPing
+{
+    /** Server time when the ping was sent, see currentTimestamp(). */
+    int64_t serverTime = 0;
+
+    /** Client time when the ping was answered, see currentTimestamp(). */
+    int64_t clientTime = 0;
+};
+
+/** @return the current system time in microseconds since the epoch. */
+inline int64_t currentTimestamp()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+        .count();
+}
+}
+
+#endif
@@ -41,6 +41,8 @@
 #include "ImageSegmenter.h"
 
 #include "ImageWrapper.h"
+#include "StreamStatisticsCollector.h"
+#include "Tracer.h"
 #ifdef DEFLECT_USE_LIBJPEGTURBO
 #include "ImageJpegCompressor.h"
 #endif
@@ -61,13 +63,44 @@ bool ImageSegmenter::_isOnRightSideOfSideBySideImage(const SegmentTask& segment)
 
 bool ImageSegmenter::generate(const ImageWrapper& image, Handler handler)
 {
+    if (_statistics)
+        _statistics->beginEncoding();
+
     if (image.compressionPolicy == COMPRESSION_ON)
-        return _generateJpeg(image, handler);
+        return _generateJpeg(_generateSegmentTasks(image), handler);
     return _generateRaw(image, handler);
 }
 
+bool ImageSegmenter::generate(const std::vector<ImageWrapper>& images,
+                              Handler handler)
+{
+    if (_statistics)
+        _statistics->beginEncoding();
+
+    SegmentTasks segments;
+    for (const auto& image : images)
+    {
+        if (image.compressionPolicy != COMPRESSION_ON)
+        {
+            if (!_generateRaw(image, handler))
+                return false;
+            continue;
+        }
+        auto imageSegments = _generateSegmentTasks(image);
+        segments.insert(segments.end(), imageSegments.begin(),
+                        imageSegments.end());
+    }
+
+    if (segments.empty())
+        return true;
+    return _generateJpeg(std::move(segments), handler);
+}
+
 Segment ImageSegmenter::createSingleSegment(const ImageWrapper& image)
 {
+    if (_statistics)
+        _statistics->beginEncoding();
+
     auto segments = _generateSegmentTasks(image);
     if (segments.size() > 1)
         throw std::runtime_error(
@@ -99,6 +132,41 @@ Segment ImageSegmenter::createSingleSegment(const ImageWrapper& image)
     return segment;
 }
 
+Segments ImageSegmenter::createSegments(const ImageWrapper& image)
+{
+    if (_statistics)
+        _statistics->beginEncoding();
+
+    Segments segments;
+    if (image.compressionPolicy != COMPRESSION_ON)
+    {
+        _generateRaw(image, [&segments](const Segment& segment) {
+            segments.push_back(segment);
+            return true;
+        });
+        return segments;
+    }
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    for (auto& segment : _generateSegmentTasks(image))
+    {
+        _computeJpeg(segment, false);
+        if (segment.exception)
+            std::rethrow_exception(segment.exception);
+        segments.push_back(segment);
+    }
+    return segments;
+#else
+    throw std::runtime_error(
+        "LibJpegTurbo not available, needed for sending JPEG compressed image");
+#endif
+}
+
+void ImageSegmenter::setStatisticsCollector(
+    StreamStatisticsCollector* statistics)
+{
+    _statistics = statistics;
+}
+
 void ImageSegmenter::setNominalSegmentDimensions(const uint width,
                                                  const uint height)
 {
@@ -106,13 +174,10 @@ void ImageSegmenter::setNominalSegmentDimensions(const uint width,
     _nominalSegmentHeight = height;
 }
 
-bool ImageSegmenter::_generateJpeg(const ImageWrapper& image,
+bool ImageSegmenter::_generateJpeg(SegmentTasks segments,
                                    const Handler& handler)
 {
 #ifdef DEFLECT_USE_LIBJPEGTURBO
-    // The resulting Jpeg segments
-    auto segments = _generateSegmentTasks(image);
-
     // start creating JPEGs for each segment, in parallel
     QtConcurrent::map(segments, std::bind(&ImageSegmenter::_computeJpeg, this,
                                           std::placeholders::_1, true));
@@ -154,6 +219,8 @@ bool ImageSegmenter::_generateJpeg(const ImageWrapper& image,
 void ImageSegmenter::_computeJpeg(SegmentTask& segment, const bool sendSegment)
 {
 #ifdef DEFLECT_USE_LIBJPEGTURBO
+    const TraceScope trace{"client", "compressSegment"};
+
     QRect imageRegion(segment.parameters.x - segment.sourceImage->x,
                       segment.parameters.y - segment.sourceImage->y,
                       segment.parameters.width, segment.parameters.height);
@@ -164,6 +231,7 @@ void ImageSegmenter::_computeJpeg(SegmentTask& segment, const bool sendSegment)
     // turbojpeg handles need to be per thread, and this function is called from
     // multiple threads by QtConcurrent::map
     static QThreadStorage<ImageJpegCompressor> compressor;
+    const auto start = StreamStatisticsCollector::Clock::now();
     try
     {
         segment.imageData =
@@ -174,6 +242,11 @@ void ImageSegmenter::_computeJpeg(SegmentTask& segment, const bool sendSegment)
     {
         segment.exception = std::current_exception();
     }
+    if (_statistics)
+    {
+        _statistics->addSegmentEncoding(
+            start, StreamStatisticsCollector::Clock::now());
+    }
 
     segment.parameters.format = Format::jpeg;
     if (sendSegment)
@@ -187,6 +260,7 @@ bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
     auto segments = _generateSegmentTasks(image);
     for (auto& segment : segments)
     {
+        const auto start = StreamStatisticsCollector::Clock::now();
         segment.imageData.reserve(segment.parameters.width *
                                   segment.parameters.height *
                                   image.getBytesPerPixel());
@@ -219,6 +293,12 @@ bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
             }
         }
 
+        if (_statistics)
+        {
+            _statistics->addSegmentEncoding(
+                start, StreamStatisticsCollector::Clock::now());
+        }
+
         if (!handler(segment))
             return false;
     }
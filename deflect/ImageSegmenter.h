@@ -79,6 +79,25 @@ public:
      */
     DEFLECT_API bool generate(const ImageWrapper& image, Handler handler);
 
+    /**
+     * Generate the segments of several images, such as the views or channels
+     * of a frame.
+     *
+     * The segments of all the images to compress are compressed together in a
+     * single parallel pass, so that the images of unbalanced sizes do not
+     * wait for each other. The segments of uncompressed images are handled
+     * first.
+     *
+     * @param images The images to be segmented.
+     * @param handler the function to handle the generated segment.
+     * @return true if all image handlers returned true, false on failure.
+     * @throw std::runtime_error if JPEG compression failed.
+     * @throw std::invalid_argument if JPEG compression arguments are invalid.
+     * @see generate(const ImageWrapper&, Handler)
+     */
+    DEFLECT_API bool generate(const std::vector<ImageWrapper>& images,
+                              Handler handler);
+
     /**
      * Set the nominal segment dimensions.
      *
@@ -106,6 +125,20 @@ public:
      */
     DEFLECT_API Segment createSingleSegment(const ImageWrapper& image);
 
+    /**
+     * Segment and compress an image of any size in the calling thread.
+     *
+     * @param image The image to be segmented.
+     * @return the segments, compressed if requested by the image.
+     * @throw std::runtime_error if JPEG compression failed.
+     * @throw std::invalid_argument if JPEG compression arguments are invalid.
+     * @threadsafe
+     */
+    DEFLECT_API Segments createSegments(const ImageWrapper& image);
+
+    /** Report the encoding time of the segments to a collector. */
+    void setStatisticsCollector(StreamStatisticsCollector* statistics);
+
 private:
     struct SegmentationInfo
     {
@@ -129,11 +162,12 @@ private:
     };
     static bool _isOnRightSideOfSideBySideImage(const SegmentTask& segment);
 
-    bool _generateJpeg(const ImageWrapper& image, const Handler& handler);
+    using SegmentTasks = std::vector<SegmentTask>;
+
+    bool _generateJpeg(SegmentTasks segments, const Handler& handler);
     void _computeJpeg(SegmentTask& segment, bool sendSegment);
     bool _generateRaw(const ImageWrapper& image, const Handler& handler) const;
 
-    using SegmentTasks = std::vector<SegmentTask>;
     SegmentTasks _generateSegmentTasks(const ImageWrapper& image) const;
 
     using SegmentParametersList = std::vector<SegmentParameters>;
@@ -145,6 +179,8 @@ private:
     uint _nominalSegmentHeight = 0;
 
     MTQueue<SegmentTask> _sendQueue;
+
+    StreamStatisticsCollector* _statistics = nullptr;
 };
 }
 #endif
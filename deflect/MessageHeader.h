@@ -70,7 +70,13 @@ enum MessageType
     MESSAGE_TYPE_IMAGE_VIEW = 15,
     MESSAGE_TYPE_OBSERVER_OPEN = 16,
     MESSAGE_TYPE_IMAGE_ROW_ORDER = 17,
-    MESSAGE_TYPE_IMAGE_CHANNEL = 18
+    MESSAGE_TYPE_IMAGE_CHANNEL = 18,
+    MESSAGE_TYPE_EVENT_BATCH = 19,
+    MESSAGE_TYPE_ENABLE_FRAME_CREDITS = 20,
+    MESSAGE_TYPE_FRAME_CREDITS = 21,
+    MESSAGE_TYPE_STREAM_CLOSED = 22,
+    MESSAGE_TYPE_CLOCK_PING = 23,
+    MESSAGE_TYPE_CLOCK_PONG = 24
 };
 
 #define MESSAGE_HEADER_URI_LENGTH 64
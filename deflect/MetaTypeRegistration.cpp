@@ -41,6 +41,7 @@
 #include "Event.h"
 #include "Segment.h"
 #include "SizeHints.h"
+#include "server/Statistics.h"
 #include "server/Tile.h"
 #include "server/types.h"
 #include "types.h"
@@ -61,11 +62,17 @@ struct MetaTypeRegistration
         qRegisterMetaType<deflect::SizeHints>("deflect::SizeHints");
         qRegisterMetaType<deflect::Event>("deflect::Event");
         qRegisterMetaType<deflect::View>("deflect::View");
+        qRegisterMetaType<deflect::server::BufferPolicy>(
+            "deflect::server::BufferPolicy");
         qRegisterMetaType<deflect::server::BoolPromisePtr>(
             "deflect::server::BoolPromisePtr");
         qRegisterMetaType<deflect::server::FramePtr>(
             "deflect::server::FramePtr");
+        qRegisterMetaType<deflect::server::Statistics>(
+            "deflect::server::Statistics");
         qRegisterMetaType<deflect::server::Tile>("deflect::server::Tile");
+        qRegisterMetaType<deflect::server::TileQueuePtr>(
+            "deflect::server::TileQueuePtr");
     }
 };
 
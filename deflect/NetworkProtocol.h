@@ -39,7 +39,13 @@
 #ifndef DEFLECT_NETWORK_PROTOCOL_H
 #define DEFLECT_NETWORK_PROTOCOL_H
 
-#define NETWORK_PROTOCOL_VERSION 8
+#define NETWORK_PROTOCOL_VERSION 13
+#define MIN_SERVER_PROTOCOL_VERSION 8 // oldest server accepted by the clients
+#define FRAME_INFO_PROTOCOL_VERSION 9 // FrameInfo sent with FINISH_FRAME
+#define EVENT_BATCH_PROTOCOL_VERSION 10 // clients accept EVENT_BATCH messages
+#define MULTIPLEXING_PROTOCOL_VERSION 11 // several streams per connection
+#define FRAME_CREDIT_PROTOCOL_VERSION 12 // servers grant frame credits
+#define CLOCK_SYNC_PROTOCOL_VERSION 13 // clients answer clock pings
 #define DEFAULT_PORT_NUMBER 1701
 
 #endif
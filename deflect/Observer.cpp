@@ -75,11 +75,14 @@ Observer::Observer(StreamPrivate* impl)
 
 Observer::~Observer()
 {
+    // Stop delivering events while the observer is still complete
+    _impl->eventReader.reset();
 }
 
 bool Observer::isConnected() const
 {
-    return _impl->socket.isConnected();
+    return _impl->socket.isConnected() &&
+           !_impl->socket.isStreamClosed(_impl->id);
 }
 
 const std::string& Observer::getId() const
@@ -109,6 +112,14 @@ bool Observer::registerForEvents(const bool exclusive)
     if (isRegisteredForEvents())
         return true;
 
+    if (!_impl->ownsConnection)
+    {
+        std::cerr << "deflect::Stream::registerForEvents: only the stream "
+                  << "which opened the connection can receive events"
+                  << std::endl;
+        return false;
+    }
+
     // Send the bind message
     if (!_impl->bindEvents(exclusive).get())
     {
@@ -149,11 +160,20 @@ int Observer::getDescriptor() const
 
 bool Observer::hasEvent() const
 {
-    return _impl->socket.hasMessage(Event::serializedSize);
+    return !_impl->pendingEvents.empty() ||
+           _impl->socket.hasMessage();
 }
 
 Event Observer::getEvent()
 {
+    auto& pendingEvents = _impl->pendingEvents;
+    if (!pendingEvents.empty())
+    {
+        const auto event = pendingEvents.front();
+        pendingEvents.pop_front();
+        return event;
+    }
+
     MessageHeader mh;
     QByteArray message;
     if (!_impl->socket.receive(mh, message))
@@ -161,6 +181,19 @@ Event Observer::getEvent()
         std::cerr << "deflect::Stream::getEvent: receive failed" << std::endl;
         return Event();
     }
+    if (mh.type == MESSAGE_TYPE_EVENT_BATCH)
+    {
+        // Keep all but the first event for the next calls
+        QDataStream stream(message);
+        const auto count = message.size() / Event::serializedSize;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Event event;
+            stream >> event;
+            pendingEvents.push_back(event);
+        }
+        return pendingEvents.empty() ? Event() : getEvent();
+    }
     if (mh.type != MESSAGE_TYPE_EVENT)
     {
         std::cerr << "deflect::Stream::getEvent: received unexpected message "
@@ -178,6 +211,16 @@ Event Observer::getEvent()
     return event;
 }
 
+void Observer::setEventCallback(std::function<void(Event)> callback)
+{
+    _impl->eventReader.reset();
+    if (callback)
+    {
+        _impl->eventReader.reset(
+            new EventReader(*this, _impl->socket, std::move(callback)));
+    }
+}
+
 void Observer::setDisconnectedCallback(const std::function<void()> callback)
 {
     _impl->disconnectedCallback = callback;
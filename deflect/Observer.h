@@ -176,7 +176,8 @@ public:
      * Having this descriptor lets a Observer class user detect when the Stream
      * has received any data. The user can the use query the state of the
      * Observer, for example using hasEvent(), and process the events
-     * accordingly.
+     * accordingly. As several events can be received at once, all of them
+     * should be processed in a while(hasEvent()) loop.
      *
      * @return The native descriptor if available; otherwise returns -1.
      * @version 1.0
@@ -209,6 +210,19 @@ public:
      */
     DEFLECT_API Event getEvent();
 
+    /**
+     * Set a function to be called with each Event as soon as it is received.
+     *
+     * The events are read by an internal thread which only wakes up when data
+     * is received, and the callback is called from that thread. A final
+     * EVT_CLOSE event is delivered if the connection is lost. While a callback
+     * is set, hasEvent() and getEvent() must not be used.
+     *
+     * @param callback the function to call, or nullptr to stop the delivery.
+     *        Must not be called from the callback itself.
+     */
+    DEFLECT_API void setEventCallback(std::function<void(Event)> callback);
+
     /**
      * Set a function to be be called just after the observer gets disconnected.
      *
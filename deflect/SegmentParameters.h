@@ -74,7 +74,7 @@ struct SegmentParameters
     /**
      * WARNING:
      * Extending this struct breaks compatibility with current
-     * NETWORK_PROTOCOL_VERSION == 8. This is due to the use of
+     * NETWORK_PROTOCOL_VERSION >= 8. This is due to the use of
      * sizeof(SegmentParameters) in (de)serialization code.
      */
 };
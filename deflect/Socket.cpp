@@ -40,8 +40,10 @@
 
 #include "Socket.h"
 
+#include "FrameInfo.h"
 #include "MessageHeader.h"
 #include "NetworkProtocol.h"
+#include "Tracer.h"
 
 #include <QCoreApplication>
 #include <QDataStream>
@@ -58,11 +60,26 @@ const int RECEIVE_TIMEOUT_MS = 1000;
 
 namespace deflect
 {
-Socket::Socket(const std::string& host, const unsigned short port)
+/** Lock the socket, notifying the readers which found it in use on release. */
+struct Socket::SocketLocker
+{
+    explicit SocketLocker(Socket& socket_)
+        : socket(socket_)
+    {
+        socket._socketMutex.lock();
+    }
+    ~SocketLocker() { socket._releaseSocket(); }
+    Socket& socket;
+};
+
+Socket::Socket(const std::string& host, const unsigned short port,
+               const bool connect)
     : _host(host)
+    , _port(port)
     , _socket(new QTcpSocket(this)) // Ensure that _socket parent is
                                     // *this* so it gets moved to thread
     , _serverProtocolVersion(INVALID_NETWORK_PROTOCOL_VERSION)
+    , _producerToken(_receivedMessages)
 {
     // disable warnings which occur if no QCoreApplication is present during
     // _connect(): QObject::connect: Cannot connect (null)::destroyed() to
@@ -70,7 +87,8 @@ Socket::Socket(const std::string& host, const unsigned short port)
     if (!qApp)
         QLoggingCategory::defaultCategory()->setEnabled(QtWarningMsg, false);
 
-    _connect(host, port);
+    if (connect)
+        _connect(host, port);
 
     QObject::connect(_socket, &QTcpSocket::disconnected, this,
                      &Socket::disconnected);
@@ -86,6 +104,15 @@ unsigned short Socket::getPort() const
     return _socket->peerPort();
 }
 
+void Socket::connectToHost()
+{
+    {
+        SocketLocker locker(*this);
+        _connect(_host, _port);
+    }
+    emit connected();
+}
+
 bool Socket::isConnected() const
 {
     return _socket->state() == QTcpSocket::ConnectedState;
@@ -101,46 +128,218 @@ int Socket::getFileDescriptor() const
     return _socket->socketDescriptor();
 }
 
-bool Socket::hasMessage(const size_t messageSize) const
+bool Socket::hasMessage()
 {
-    QMutexLocker locker(&_socketMutex);
+    if (_receivedMessages.size_approx() > 0)
+        return true;
+
+    tryReceiveAvailableMessages();
+    return _receivedMessages.size_approx() > 0;
+}
+
+bool Socket::tryReceiveAvailableMessages()
+{
+    // Don't wait for a send in progress, the messages it receives meanwhile
+    // are queued by the sending thread, which emits readyToReceive() once it
+    // releases the socket. The flag is raised before trying to lock so that
+    // a concurrent release cannot miss it.
+    _deferredReceive = true;
+    if (!_socketMutex.tryLock())
+        return false;
+    _deferredReceive = false;
 
     // needed to 'wakeup' socket when no data was streamed for a while
     _socket->waitForReadyRead(0);
-    return _socket->bytesAvailable() >=
-           (int)(MessageHeader::serializedSize + messageSize);
+    _receiveAvailableMessages();
+    _releaseSocket();
+    return true;
+}
+
+void Socket::receiveAvailableMessages()
+{
+    SocketLocker locker(*this);
+    _socket->waitForReadyRead(0);
+    _receiveAvailableMessages();
 }
 
 bool Socket::send(const MessageHeader& messageHeader, const QByteArray& message,
                   const bool waitForBytesWritten)
 {
-    QMutexLocker locker(&_socketMutex);
-    if (!isConnected())
-        return false;
+    const TraceScope trace{"client", "Socket::send"};
 
-    // send header
-    QDataStream stream(_socket);
-    stream << messageHeader;
-    if (stream.status() != QDataStream::Ok)
-        return false;
+    // The senders are serialized by their own mutex. The socket mutex is only
+    // held for each step of the write, so that the readers can use the socket
+    // in between instead of waiting for the whole message to be written.
+    QMutexLocker sendLocker(&_sendMutex);
+    bool allSent = false;
+    {
+        SocketLocker locker(*this);
+        if (!isConnected())
+            return false;
+
+        // send header
+        QDataStream stream(_socket);
+        stream << messageHeader;
+        if (stream.status() != QDataStream::Ok)
+            return false;
 
-    // send message
-    const bool allSent = _write(message);
+        // send message
+        allSent = _write(message);
+    }
 
-    if (waitForBytesWritten)
+    bool writing = waitForBytesWritten;
+    do
     {
+        SocketLocker locker(*this);
         // Needed in the absence of event loop, otherwise the reception is
         // frozen.
-        while (_socket->bytesToWrite() > 0 && isConnected())
+        writing = writing && _socket->bytesToWrite() > 0 && isConnected();
+        if (writing)
             _socket->waitForBytesWritten();
-    }
+
+        // Incoming data is buffered while writing, queue it for hasMessage()
+        // after each step rather than once the message is written.
+        _receiveAvailableMessages();
+    } while (writing);
+
     return allSent;
 }
 
 bool Socket::receive(MessageHeader& messageHeader, QByteArray& message)
 {
-    QMutexLocker locker(&_socketMutex);
+    Message received;
+    if (!_receivedMessages.try_dequeue_from_producer(_producerToken, received))
+    {
+        SocketLocker locker(*this);
+
+        // Messages may have been queued while waiting for the lock
+        if (!_receivedMessages.try_dequeue_from_producer(_producerToken,
+                                                         received))
+        {
+            return _receive(messageHeader, message);
+        }
+    }
 
+    messageHeader = received.header;
+    message = received.data;
+    return messageHeader.type != MESSAGE_TYPE_QUIT;
+}
+
+uint32_t Socket::takeFrameCredits(const std::string& id)
+{
+    QMutexLocker locker(&_streamsMutex);
+    const auto it = _frameCredits.find(id);
+    if (it == _frameCredits.end())
+        return 0;
+
+    const auto credits = it->second;
+    _frameCredits.erase(it);
+    return credits;
+}
+
+void Socket::_addFrameCredits(const MessageHeader& header,
+                              const QByteArray& data)
+{
+    if (data.size() < int(sizeof(uint32_t)))
+        return;
+
+    const auto credits = *reinterpret_cast<const uint32_t*>(data.data());
+    QMutexLocker locker(&_streamsMutex);
+    _frameCredits[header.uri] += credits;
+}
+
+bool Socket::isStreamClosed(const std::string& id) const
+{
+    QMutexLocker locker(&_streamsMutex);
+    return _closedStreams.count(id) > 0;
+}
+
+void Socket::removeStream(const std::string& id)
+{
+    QMutexLocker locker(&_streamsMutex);
+    _frameCredits.erase(id);
+    _closedStreams.erase(id);
+}
+
+void Socket::_closeStream(const std::string& id)
+{
+    {
+        QMutexLocker locker(&_streamsMutex);
+        _closedStreams.insert(id);
+    }
+    emit streamClosed(id);
+}
+
+void Socket::_answerClockPing(const MessageHeader& header, QByteArray& data)
+{
+    if (data.size() < int(sizeof(ClockPing)))
+        return;
+
+    // Answered as soon as it is read, the socket is locked by the caller
+    auto ping = reinterpret_cast<ClockPing*>(data.data());
+    ping->clientTime = currentTimestamp();
+
+    QDataStream stream(_socket);
+    stream << MessageHeader(MESSAGE_TYPE_CLOCK_PONG, data.size(), header.uri);
+    if (stream.status() == QDataStream::Ok && _write(data))
+        _socket->flush();
+}
+
+void Socket::_releaseSocket()
+{
+    _socketMutex.unlock();
+    if (_deferredReceive.exchange(false))
+        emit readyToReceive();
+}
+
+void Socket::_receiveAvailableMessages()
+{
+    const auto headerSize = qint64(MessageHeader::serializedSize);
+    size_t count = 0;
+    while (_socket->bytesAvailable() >= headerSize)
+    {
+        Message received;
+        {
+            const auto headerData = _socket->peek(headerSize);
+            QDataStream stream(headerData);
+            stream >> received.header;
+            if (stream.status() != QDataStream::Ok)
+                break;
+        }
+        if (_socket->bytesAvailable() < headerSize + received.header.size)
+            break;
+
+        _socket->read(headerSize);
+        received.data = _socket->read(received.header.size);
+
+        if (received.header.type == MESSAGE_TYPE_FRAME_CREDITS)
+        {
+            _addFrameCredits(received.header, received.data);
+            continue;
+        }
+        if (received.header.type == MESSAGE_TYPE_STREAM_CLOSED)
+        {
+            _closeStream(received.header.uri);
+            continue;
+        }
+        if (received.header.type == MESSAGE_TYPE_CLOCK_PING)
+        {
+            _answerClockPing(received.header, received.data);
+            continue;
+        }
+
+        if (received.header.type == MESSAGE_TYPE_QUIT)
+            _socket->disconnectFromHost();
+
+        _receivedMessages.enqueue(_producerToken, std::move(received));
+        ++count;
+    }
+    if (count > 0)
+        emit messagesReceived();
+}
+
+bool Socket::_receive(MessageHeader& messageHeader, QByteArray& message)
+{
     if (!_receiveHeader(messageHeader))
         return false;
 
@@ -164,6 +363,27 @@ bool Socket::receive(MessageHeader& messageHeader, QByteArray& message)
         return false;
     }
 
+    if (messageHeader.type == MESSAGE_TYPE_FRAME_CREDITS)
+    {
+        _addFrameCredits(messageHeader, message);
+        message.clear();
+        return _receive(messageHeader, message);
+    }
+
+    if (messageHeader.type == MESSAGE_TYPE_STREAM_CLOSED)
+    {
+        _closeStream(messageHeader.uri);
+        message.clear();
+        return _receive(messageHeader, message);
+    }
+
+    if (messageHeader.type == MESSAGE_TYPE_CLOCK_PING)
+    {
+        _answerClockPing(messageHeader, message);
+        message.clear();
+        return _receive(messageHeader, message);
+    }
+
     return true;
 }
 
@@ -197,12 +417,12 @@ void Socket::_connect(const std::string& host, const unsigned short port)
         throw std::runtime_error("server protocol version was not received");
     }
 
-    if (_serverProtocolVersion < NETWORK_PROTOCOL_VERSION)
+    if (_serverProtocolVersion < MIN_SERVER_PROTOCOL_VERSION)
     {
         _socket->disconnectFromHost();
         std::stringstream ss;
         ss << "server uses unsupported protocol: " << _serverProtocolVersion
-           << " < " << NETWORK_PROTOCOL_VERSION;
+           << " < " << MIN_SERVER_PROTOCOL_VERSION;
         throw std::runtime_error(ss.str());
     }
 }
@@ -45,9 +45,15 @@
 typedef __int32 int32_t;
 #endif
 
+#include <deflect/MessageHeader.h>
 #include <deflect/api.h>
 #include <deflect/types.h>
 
+#include "moodycamel/concurrentqueue.h"
+
+#include <atomic>
+#include <map>
+#include <set>
 #include <string>
 
 #include <QByteArray>
@@ -60,6 +66,15 @@ namespace deflect
 {
 /**
  * Represent a communication Socket for the Stream Library.
+ *
+ * Messages are received in a queue by whichever thread uses the socket, so
+ * that hasMessage() never waits for a send() in progress in another thread
+ * and returns immediately when a message has already been received.
+ *
+ * The QTcpSocket can only be used by one thread at a time. send() holds it
+ * for each step of a large write only, and queues the messages received
+ * during that step, so that they are available to the readers while the
+ * rest of the message is being written.
  */
 class Socket : public QObject
 {
@@ -70,9 +85,12 @@ public:
      * Construct a Socket and connect to host.
      * @param host The target host (IP address or hostname)
      * @param port The target port
+     * @param connect if false, connectToHost() must be called before use,
+     *        for instance from the thread that the socket was moved to.
      * @throw std::runtime_error if the socket could not connect
      */
-    DEFLECT_API Socket(const std::string& host, unsigned short port);
+    DEFLECT_API Socket(const std::string& host, unsigned short port,
+                       bool connect = true);
 
     /** Destruct a Socket, disconnecting from host. */
     DEFLECT_API ~Socket() = default;
@@ -83,6 +101,12 @@ public:
     /** Get the remote port the socket is connected to. */
     unsigned short getPort() const;
 
+    /**
+     * Connect to the host given to the constructor and do the handshake.
+     * @throw std::runtime_error if the socket could not connect
+     */
+    void connectToHost();
+
     /** Is the Socket connected */
     DEFLECT_API bool isConnected() const;
 
@@ -96,10 +120,28 @@ public:
     int getFileDescriptor() const;
 
     /**
-     * Is there a pending message
-     * @param messageSize Minimum size of the message
+     * Is there a complete pending message.
+     *
+     * Does not wait if another thread is currently using the socket, in which
+     * case only the messages already received are considered.
+     */
+    bool hasMessage();
+
+    /**
+     * Queue all the complete messages available on the socket, waiting for
+     * another thread currently using it if needed.
+     */
+    void receiveAvailableMessages();
+
+    /**
+     * Queue all the complete messages available on the socket, unless another
+     * thread is currently using it.
+     *
+     * In that case, the other thread queues the messages it receives and
+     * emits readyToReceive() once it releases the socket.
+     * @return false if the socket was in use by another thread
      */
-    bool hasMessage(const size_t messageSize = 0) const;
+    bool tryReceiveAvailableMessages();
 
     /**
      * Send a message.
@@ -114,23 +156,81 @@ public:
               bool waitForBytesWritten);
 
     /**
-     * Receive a message.
+     * Receive a message, waiting for it if none is pending.
      * @param messageHeader The received message header
      * @param message The received message data
      * @return true if a message could be received, false otherwise
      */
     bool receive(MessageHeader& messageHeader, QByteArray& message);
 
+    /**
+     * Take the frame credits received for a stream.
+     *
+     * The credit messages are counted by the thread receiving them instead of
+     * being queued with the other messages.
+     * @param id the identifier of the stream
+     * @return the number of credits received since the last call
+     */
+    uint32_t takeFrameCredits(const std::string& id);
+
+    /**
+     * @param id the identifier of a stream multiplexed over the socket
+     * @return true if the server has closed the stream.
+     */
+    bool isStreamClosed(const std::string& id) const;
+
+    /** Forget the state of a stream which is no longer used. */
+    void removeStream(const std::string& id);
+
 signals:
+    /** Signal that the socket has connected and done the handshake. */
+    void connected();
+
     /** Signal that the socket has been disconnected. */
     void disconnected();
 
+    /** Signal that new messages were queued, emitted by the reading thread. */
+    void messagesReceived();
+
+    /** Signal that the server closed a stream, from the reading thread. */
+    void streamClosed(const std::string& id);
+
+    /**
+     * Signal that the socket was released after a tryReceiveAvailableMessages()
+     * found it in use, emitted by the thread which released it.
+     */
+    void readyToReceive();
+
 private:
     const std::string _host;
+    const unsigned short _port;
     QTcpSocket* _socket; // Child QObject
-    mutable QMutex _socketMutex;
+    mutable QMutex _socketMutex; // held for each use of _socket
+    QMutex _sendMutex;           // held for each send()
+    std::atomic<bool> _deferredReceive{false};
+    struct SocketLocker;
     int32_t _serverProtocolVersion;
 
+    struct Message
+    {
+        MessageHeader header;
+        QByteArray data;
+    };
+    // Filled with the mutex locked, using a single token to preserve order.
+    moodycamel::ConcurrentQueue<Message> _receivedMessages;
+    moodycamel::ProducerToken _producerToken;
+
+    // Per-stream messages, handled by the thread receiving them
+    mutable QMutex _streamsMutex;
+    std::map<std::string, uint32_t> _frameCredits;
+    std::set<std::string> _closedStreams;
+
+    void _releaseSocket();
+    void _addFrameCredits(const MessageHeader& header, const QByteArray& data);
+    void _closeStream(const std::string& id);
+    void _answerClockPing(const MessageHeader& header, QByteArray& data);
+    void _receiveAvailableMessages();
+    bool _receive(MessageHeader& messageHeader, QByteArray& message);
     bool _receiveHeader(MessageHeader& messageHeader);
     void _connect(const std::string& host, const unsigned short port);
     bool _receiveProtocolVersion();
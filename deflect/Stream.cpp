@@ -60,6 +60,25 @@ Stream::Stream(const std::string& id, const std::string& host,
 {
 }
 
+Stream::Stream(const std::string& id, Stream& connection)
+    : Observer(new StreamPrivate(id, *connection._impl))
+{
+}
+
+Stream::Stream(StreamPrivate* impl)
+    : Observer(impl)
+{
+}
+
+std::unique_ptr<Stream> Stream::connectAsync(const std::string& id,
+                                             const std::string& host,
+                                             const unsigned short port,
+                                             ConnectedCallback callback)
+{
+    return std::unique_ptr<Stream>(new Stream(
+        new StreamPrivate(id, host, port, false, true, std::move(callback))));
+}
+
 Stream::~Stream()
 {
 }
@@ -69,6 +88,11 @@ Stream::Future Stream::send(const ImageWrapper& image)
     return _impl->sendImage(image, false);
 }
 
+Stream::Future Stream::send(const std::vector<ImageWrapper>& images)
+{
+    return _impl->sendImages(images, false);
+}
+
 Stream::Future Stream::finishFrame()
 {
     return _impl->sendFinishFrame();
@@ -78,4 +102,41 @@ Stream::Future Stream::sendAndFinish(const ImageWrapper& image)
 {
     return _impl->sendImage(image, true);
 }
+
+Stream::Future Stream::sendSegment(const Segment& segment)
+{
+    return _impl->sendSegment(segment);
+}
+
+Stream::Future Stream::send(const ImageWrapper& image,
+                            const uint64_t frameNumber)
+{
+    return _impl->sendImage(image, frameNumber);
+}
+
+Stream::Future Stream::finishFrame(const uint64_t frameNumber)
+{
+    return _impl->sendFinishFrame(frameNumber);
+}
+
+void Stream::setSendPolicy(const SendPolicy policy,
+                           const size_t maxQueuedFrames)
+{
+    _impl->setSendPolicy(policy, maxQueuedFrames);
+}
+
+bool Stream::enableFrameCredits()
+{
+    return _impl->enableFrameCredits();
+}
+
+bool Stream::canSendFrame()
+{
+    return _impl->canSendFrame();
+}
+
+StreamStatistics Stream::getStatistics() const
+{
+    return _impl->statistics.getStatistics();
+}
 }
@@ -44,6 +44,7 @@
 
 #include <deflect/ImageWrapper.h>
 #include <deflect/Observer.h>
+#include <deflect/StreamStatistics.h>
 #include <deflect/api.h>
 #include <deflect/types.h>
 
@@ -113,6 +114,52 @@ public:
     DEFLECT_API Stream(const std::string& id, const std::string& host,
                        unsigned short port = defaultPortNumber);
 
+    /** Function called with the result of an asynchronous connection. */
+    using ConnectedCallback = std::function<void(bool)>;
+
+    /**
+     * Open a new connection to the Server without blocking the caller.
+     *
+     * The host lookup, connection and protocol handshake are done by the send
+     * thread of the stream, so that opening many streams takes about one round
+     * trip instead of one per stream. Images can be sent right away; they are
+     * queued until the connection is established, and their futures return
+     * false if it could not be.
+     *
+     * @param id The identifier for the stream, see Stream().
+     * @param host The address of the target Server instance, see Stream().
+     * @param port Port of the Server instance, default 1701.
+     * @param callback Optional function called from the send thread with the
+     *        result of the connection.
+     * @return the new stream, which is not connected yet.
+     * @throw std::runtime_error if no host was provided
+     */
+    DEFLECT_API static std::unique_ptr<Stream> connectAsync(
+        const std::string& id, const std::string& host,
+        unsigned short port = defaultPortNumber,
+        ConnectedCallback callback = ConnectedCallback());
+
+    /**
+     * Open a new stream over the connection of an existing one.
+     *
+     * Many streams can be multiplexed over a single connection and send thread,
+     * each message being tagged with the identifier of its stream. This saves
+     * a socket, a thread and a handshake per stream when an application streams
+     * many windows. The connection is closed with the last of its streams.
+     *
+     * The multiplexed streams share the statistics of the connection, and only
+     * the stream which opened the connection can register for events. When the
+     * server closes one of them, only this stream is disconnected: its sends
+     * fail and its disconnected callback is called.
+     *
+     * @param id The identifier for the stream, which must differ from the
+     *           ones of the other streams of the connection.
+     * @param connection The stream whose connection is shared.
+     * @throw std::runtime_error if the server does not support multiplexing
+     *        or the stream could not be opened.
+     */
+    DEFLECT_API Stream(const std::string& id, Stream& connection);
+
     /** Destruct the Stream, closing the connection. @version 1.0 */
     DEFLECT_API virtual ~Stream();
 
@@ -136,6 +183,26 @@ public:
      */
     DEFLECT_API Future send(const ImageWrapper& image);
 
+    /**
+     * Send several images of the current frame asynchronously.
+     *
+     * This is meant for the views of a stereo frame or the channels of a
+     * multi-channel frame. The segments of all the images are compressed in a
+     * single parallel pass, instead of one image after the other as with
+     * successive send() calls.
+     *
+     * @param images The images to send. Note that their data is not copied,
+     *               so it must remain valid until the send is finished.
+     * @return true if the image data could be sent, false otherwise
+     * @throw std::invalid_argument if no images are given
+     * @throw std::invalid_argument if not RGBA and uncompressed
+     * @throw std::invalid_argument if invalid JPEG compression arguments
+     * @throw std::runtime_error if pending finishFrame() has not been completed
+     * @throw std::runtime_error if JPEG compression failed
+     * @sa finishFrame()
+     */
+    DEFLECT_API Future send(const std::vector<ImageWrapper>& images);
+
     /**
      * Asynchronously notify that all the images for this frame have been sent.
      *
@@ -168,13 +235,130 @@ public:
      * @version 1.0
      */
     DEFLECT_API Future sendAndFinish(const ImageWrapper& image);
+
+    /**
+     * Send a segment which has already been encoded.
+     *
+     * The segment is sent as-is, without segmentation or compression. This is
+     * useful to replay recorded streams or to send the output of an external
+     * encoder. The frame must be completed with finishFrame() as for send().
+     *
+     * The segment is validated before being queued: it must have a non-empty
+     * size, and its data must either be a JPEG image or match its size in
+     * Format::rgba.
+     *
+     * @param segment The segment to send, in Format::jpeg or Format::rgba.
+     * @return true if the segment was successfully sent, false otherwise
+     * @throw std::invalid_argument if the segment format, size or data is
+     *        invalid
+     * @throw std::runtime_error if pending finishFrame() has not been completed
+     * @sa finishFrame()
+     */
+    DEFLECT_API Future sendSegment(const Segment& segment);
+
+    /**
+     * Send an image of a frame, from any thread.
+     *
+     * Several threads can send their own images of the same frame at the same
+     * time. Each image is segmented and compressed in the calling thread, so
+     * that the encoding scales with the threads of the application. The
+     * images are tagged with their frame number: a thread can already send the
+     * images of the next frame, which are only sent once the current frame is
+     * finished.
+     *
+     * This is not to be mixed with send() and finishFrame() for the same
+     * stream.
+     *
+     * @param image The image to send, which is compressed before returning.
+     * @param frameNumber The frame of the image, starting from 1 and
+     *        incremented by one for each frame. A frame can only be started
+     *        after all the previous ones.
+     * @return true if the image data could be sent, false otherwise
+     * @throw std::invalid_argument if invalid JPEG compression arguments
+     * @throw std::runtime_error if the frame was already finished
+     * @throw std::runtime_error if the frame skips a frame number
+     * @throw std::runtime_error if JPEG compression failed
+     * @threadsafe
+     * @sa finishFrame(uint64_t)
+     */
+    DEFLECT_API Future send(const ImageWrapper& image, uint64_t frameNumber);
+
+    /**
+     * Notify that all the images of a frame have been sent.
+     *
+     * This must be called once per frame, after all the threads have returned
+     * from send(image, frameNumber) for this frame. The frame is finished once
+     * all of their images have been sent.
+     *
+     * @param frameNumber The frame to finish.
+     * @return true if the frame was finished, false otherwise
+     * @throw std::runtime_error if the frame was already finished
+     * @throw std::runtime_error if the frame skips a frame number
+     * @threadsafe
+     */
+    DEFLECT_API Future finishFrame(uint64_t frameNumber);
+
+    /**
+     * Bound the number of frames waiting to be sent.
+     *
+     * A frame is queued from its first send until its finishFrame() has been
+     * sent. When the limit is reached, starting a new frame either waits for a
+     * queued frame to be sent, or drops the oldest frame whose segments are not
+     * being sent yet. The futures of a dropped frame throw a
+     * FrameDroppedError, which tells them apart from the frames which could
+     * not be sent (false), and getStatistics() counts the dropped frames. If
+     * all the queued frames are being sent, the new frame waits for one of
+     * them with both policies.
+     *
+     * This keeps the latency of interactive streams bounded when the network
+     * is slower than the rendering.
+     *
+     * @param policy what to do when the limit is reached.
+     * @param maxQueuedFrames the maximum number of queued frames, 0 for no
+     *        limit (default). The new limit applies from the next frame.
+     * @threadsafe
+     */
+    DEFLECT_API void setSendPolicy(SendPolicy policy, size_t maxQueuedFrames);
+
+    /**
+     * Let the server pace the frames of the stream with frame credits.
+     *
+     * The server grants one credit initially, then one each time it dispatches
+     * a frame of the stream to its application. Each finished frame uses one
+     * credit. Producers can check canSendFrame() before rendering a frame, to
+     * only render the frames which will be displayed.
+     *
+     * @return true if the server grants frame credits, false if it is too old
+     *         or the stream is not connected.
+     */
+    DEFLECT_API bool enableFrameCredits();
+
+    /**
+     * Check if the server is ready for a new frame, without blocking.
+     *
+     * @return true if a frame credit is available, or if enableFrameCredits()
+     *         was not called.
+     */
+    DEFLECT_API bool canSendFrame();
     //@}
 
+    /**
+     * Get the performance statistics of the stream.
+     *
+     * The encoding and data size measures are computed over the last 100
+     * frames, and the send latency over the last 100 requests which returned a
+     * Future. They can be used to log the streaming cost or to adjust the
+     * compression quality and segment size.
+     *
+     * @return the statistics over the most recent frames
+     * @threadsafe
+     */
+    DEFLECT_API StreamStatistics getStatistics() const;
+
 private:
+    explicit Stream(StreamPrivate* impl);
     Stream(const Stream&) = delete;
     const Stream& operator=(const Stream&) = delete;
-
-    friend class deflect::test::Application;
 };
 }
 
@@ -45,6 +45,8 @@
 
 #include <QHostInfo>
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
 
@@ -130,54 +132,142 @@ void _checkParameters(const ImageWrapper& image)
     }
 }
 
+void _checkSegment(const Segment& segment)
+{
+    const auto& params = segment.parameters;
+    if (params.width == 0 || params.height == 0)
+        throw std::invalid_argument("Segment has an empty size");
+
+    if (params.x > std::numeric_limits<uint32_t>::max() - params.width ||
+        params.y > std::numeric_limits<uint32_t>::max() - params.height)
+    {
+        throw std::invalid_argument("Segment is out of the stream bounds");
+    }
+
+    const auto size = static_cast<size_t>(segment.imageData.size());
+    switch (params.format)
+    {
+    case Format::rgba:
+        if (size != size_t(params.width) * params.height * 4)
+        {
+            std::stringstream msg;
+            msg << "RGBA segment of " << params.width << "x" << params.height
+                << " must have " << params.width * params.height * 4
+                << " bytes of data, got " << size;
+            throw std::invalid_argument(msg.str());
+        }
+        break;
+    case Format::jpeg:
+        // All JPEG data starts with the SOI marker
+        if (size < 2 || uint8_t(segment.imageData[0]) != 0xFF ||
+            uint8_t(segment.imageData[1]) != 0xD8)
+        {
+            throw std::invalid_argument("Segment data is not a JPEG image");
+        }
+        break;
+    default:
+        throw std::invalid_argument(
+            "Segments can only be sent in RGBA or JPEG format");
+    }
+}
+
 bool _canSendAsSingleSegment(const ImageWrapper& image)
 {
     return image.width <= SMALL_IMAGE_SIZE && image.height <= SMALL_IMAGE_SIZE;
 }
 }
 
+StreamConnection::StreamConnection(const std::string& host,
+                                   const unsigned short port,
+                                   const bool connect)
+    : socket{_getStreamHost(host), _getStreamPort(port), connect}
+    , sendWorker{socket, statistics}
+{
+    socket.moveToThread(&sendWorker);
+    sendWorker.start();
+}
+
 StreamPrivate::StreamPrivate(const std::string& id_, const std::string& host,
-                             const unsigned short port, const bool observer)
+                             const unsigned short port, const bool observer,
+                             const bool connectAsync,
+                             std::function<void(bool)> connected)
     : id{_getStreamId(id_)}
-    , socket{_getStreamHost(host), _getStreamPort(port)}
-    , sendWorker{socket, id}
+    , connection{std::make_shared<StreamConnection>(host, port,
+                                                    !connectAsync)}
+    , socket(connection->socket)
+    , statistics(connection->statistics)
+    , sendWorker(connection->sendWorker)
+    , ownsConnection{true}
     , task{&sendWorker, this}
 {
-    _imageSegmenter.setNominalSegmentDimensions(SEGMENT_SIZE, SEGMENT_SIZE);
-
-    socket.connect(&socket, &Socket::disconnected, [this]() {
-        if (disconnectedCallback)
-            disconnectedCallback();
-    });
-
-    socket.moveToThread(&sendWorker);
-    sendWorker.start();
+    _init();
 
-    if (observer)
+    // Requests are processed in order, the ones queued meanwhile wait for the
+    // connection and fail if it could not be established.
+    if (connectAsync)
+        sendWorker.enqueueRequest(task.connect(observer, std::move(connected)));
+    else if (observer)
         sendWorker.enqueueRequest(task.openObserver()).wait();
     else
         sendWorker.enqueueRequest(task.openStream()).wait();
 }
 
+StreamPrivate::StreamPrivate(const std::string& id_, StreamPrivate& other)
+    : id{_getStreamId(id_)}
+    , connection{other.connection}
+    , socket(connection->socket)
+    , statistics(connection->statistics)
+    , sendWorker(connection->sendWorker)
+    , ownsConnection{false}
+    , task{&sendWorker, this}
+{
+    // Also waits for a pending asynchronous connection of the other stream
+    if (!sendWorker.enqueueRequest(task.openMultiplexedStream()).get())
+        throw std::runtime_error("Could not open the multiplexed stream");
+
+    _init();
+}
+
 StreamPrivate::~StreamPrivate()
 {
-    if (socket.isConnected())
-        sendWorker.enqueueRequest(task.close()).wait();
+    // Also done if not connected yet, to wait for a pending connection
+    sendWorker.enqueueRequest(task.close()).wait();
+
+    QObject::disconnect(_disconnectedConnection);
+    QObject::disconnect(_streamClosedConnection);
+}
+
+void StreamPrivate::_init()
+{
+    _imageSegmenter.setNominalSegmentDimensions(SEGMENT_SIZE, SEGMENT_SIZE);
+    _imageSegmenter.setStatisticsCollector(&statistics);
+
+    _disconnectedConnection =
+        socket.connect(&socket, &Socket::disconnected, [this]() {
+            if (disconnectedCallback)
+                disconnectedCallback();
+        });
+    // The server can also close a single stream of a shared connection
+    _streamClosedConnection = socket.connect(
+        &socket, &Socket::streamClosed, [this](const std::string& closedId) {
+            if (closedId == id && disconnectedCallback)
+                disconnectedCallback();
+        });
 }
 
 Stream::Future StreamPrivate::bindEvents(const bool exclusive)
 {
-    return sendWorker.enqueueRequest(task.bindEvents(exclusive));
+    return _enqueueControl(task.bindEvents(exclusive));
 }
 
 Stream::Future StreamPrivate::send(const SizeHints& hints)
 {
-    return sendWorker.enqueueRequest(task.send(hints));
+    return _enqueueControl(task.send(hints));
 }
 
 Stream::Future StreamPrivate::send(QByteArray&& data)
 {
-    return sendWorker.enqueueRequest(task.send(std::move(data)));
+    return _enqueueControl(task.send(std::move(data)));
 }
 
 Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
@@ -189,6 +279,7 @@ Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
             throw std::runtime_error("Pending finish, no send allowed");
 
         _checkParameters(image);
+        _startFrame();
 
         if (_canSendAsSingleSegment(image))
         {
@@ -198,12 +289,16 @@ Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
             // As we expect to encounter a lot of these small sends, be
             // optimistic and fulfill the promise already to reduce load in the
             // send thread (c.f. lock ops performance on KNL).
-            sendWorker.enqueueFastRequest(task.send(std::move(segment)));
+            sendWorker.enqueueFastRequest(
+                _inFrame(task.send(std::move(segment))));
             return finish ? sendFinishFrame() : make_ready_future(true);
         }
 
+        const auto info = finish ? _finishFrame() : FrameInfo();
         return sendWorker.enqueueRequest(
-            task.sendUsingMTCompression(image, _imageSegmenter, finish));
+            _inFrame(task.sendUsingMTCompression(image, _imageSegmenter,
+                                                 finish, info),
+                     finish));
     }
     catch (...)
     {
@@ -211,14 +306,407 @@ Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
     }
 }
 
+Stream::Future StreamPrivate::sendImages(
+    const std::vector<ImageWrapper>& images, const bool finish)
+{
+    try
+    {
+        if (_pendingFinish)
+            throw std::runtime_error("Pending finish, no send allowed");
+
+        if (images.empty())
+            throw std::invalid_argument("No images to send");
+
+        for (const auto& image : images)
+            _checkParameters(image);
+        _startFrame();
+
+        const auto info = finish ? _finishFrame() : FrameInfo();
+        return sendWorker.enqueueRequest(
+            _inFrame(task.sendUsingMTCompression(images, _imageSegmenter,
+                                                 finish, info),
+                     finish));
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+}
+
+Stream::Future StreamPrivate::sendSegment(const Segment& segment)
+{
+    if (_pendingFinish)
+    {
+        return make_exception_future<bool>(
+            std::runtime_error("Pending finish, no send allowed"));
+    }
+    try
+    {
+        _checkSegment(segment);
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+    _startFrame();
+    return sendWorker.enqueueRequest(_inFrame(task.send(Segment(segment))));
+}
+
 Stream::Future StreamPrivate::sendFinishFrame()
 {
     _pendingFinish = true;
-    return sendWorker.enqueueRequest(task.finishFrame(), true);
+    return sendWorker.enqueueRequest(
+        _inFrame(task.finishFrame(_finishFrame()), true), true);
+}
+
+Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
+                                        const uint64_t frameNumber)
+{
+    try
+    {
+        _checkParameters(image);
+
+        // Compress in the calling thread, concurrently with the other ones
+        auto segments = _imageSegmenter.createSegments(image);
+
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future = promise->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_taggedFramesMutex);
+            _checkTaggedFrame(frameNumber);
+            auto& frame = _taggedFrames[frameNumber];
+            if (frame.startTime == 0)
+                frame.startTime = currentTimestamp();
+            ++frame.pendingSends;
+        }
+
+        auto stream = this;
+        sendWorker.enqueueFastRequest(
+            [stream, frameNumber, segments, promise]() {
+                stream->_sendTagged(frameNumber, segments, promise);
+                return true;
+            });
+        return future;
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+}
+
+Stream::Future StreamPrivate::sendFinishFrame(const uint64_t frameNumber)
+{
+    try
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future = promise->get_future();
+        {
+            std::lock_guard<std::mutex> lock(_taggedFramesMutex);
+            _checkTaggedFrame(frameNumber);
+            auto& frame = _taggedFrames[frameNumber];
+            if (frame.startTime == 0)
+                frame.startTime = currentTimestamp();
+            frame.finished = promise;
+        }
+
+        auto stream = this;
+        sendWorker.enqueueFastRequest([stream]() {
+            stream->_finishTaggedFrames();
+            return true;
+        });
+        return future;
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+}
+
+void StreamPrivate::setSendPolicy(const SendPolicy policy,
+                                  const size_t maxQueuedFrames)
+{
+    {
+        std::lock_guard<std::mutex> lock(_queuedFramesMutex);
+        _sendPolicy = policy;
+        _maxQueuedFrames = maxQueuedFrames;
+    }
+    _frameSent.notify_all();
+}
+
+Stream::Future StreamPrivate::_enqueueControl(Task&& controlTask)
+{
+    // Keep the order with a pending asynchronous connection
+    if (!socket.isConnected())
+        return sendWorker.enqueueRequest(std::move(controlTask));
+    return sendWorker.enqueueControlRequest(std::move(controlTask));
+}
+
+bool StreamPrivate::enableFrameCredits()
+{
+    if (!_frameCreditsEnabled &&
+        sendWorker.enqueueRequest(task.enableFrameCredits()).get())
+    {
+        _frameCreditsEnabled = true;
+    }
+    return _frameCreditsEnabled;
+}
+
+bool StreamPrivate::canSendFrame()
+{
+    if (!_frameCreditsEnabled)
+        return true;
+
+    if (_frameCredits == 0)
+    {
+        socket.tryReceiveAvailableMessages();
+        _frameCredits += socket.takeFrameCredits(id);
+    }
+    return _frameCredits > 0;
+}
+
+void StreamPrivate::_startFrame()
+{
+    if (_frameStartTime != 0)
+        return;
+
+    _queueFrame();
+    _frameStartTime = currentTimestamp();
+}
+
+FrameInfo StreamPrivate::_finishFrame()
+{
+    FrameInfo info;
+    info.frameNumber = ++_frameNumber;
+    info.timestamp = _frameStartTime ? _frameStartTime : currentTimestamp();
+    _frameStartTime = 0;
+
+    if (_frameCreditsEnabled)
+    {
+        _frameCredits += socket.takeFrameCredits(id);
+        if (_frameCredits > 0)
+            --_frameCredits;
+    }
+    return info;
+}
+
+void StreamPrivate::_checkTaggedFrame(const uint64_t frameNumber) const
+{
+    const auto it = _taggedFrames.find(frameNumber);
+    if (frameNumber < _sendingFrame ||
+        (it != _taggedFrames.end() && it->second.finished))
+    {
+        throw std::runtime_error("Frame " + std::to_string(frameNumber) +
+                                 " was already finished");
+    }
+
+    // A skipped frame would never be finished, blocking all the next ones
+    const auto lastFrame = _taggedFrames.empty()
+                               ? _sendingFrame - 1
+                               : _taggedFrames.rbegin()->first;
+    if (frameNumber > lastFrame + 1)
+    {
+        throw std::runtime_error("Frame " + std::to_string(frameNumber) +
+                                 " skips frame " +
+                                 std::to_string(lastFrame + 1));
+    }
+}
+
+void StreamPrivate::_sendTagged(const uint64_t frameNumber, Segments segments,
+                                PromisePtr promise)
+{
+    {
+        // The images of the next frames wait until the current one is sent
+        std::lock_guard<std::mutex> lock(_taggedFramesMutex);
+        if (frameNumber != _sendingFrame)
+        {
+            _taggedFrames[frameNumber].heldSends.emplace_back(
+                std::move(segments), std::move(promise));
+            return;
+        }
+    }
+    _sendSegments(frameNumber, segments, promise);
+    _finishTaggedFrames();
+}
+
+void StreamPrivate::_sendSegments(const uint64_t frameNumber,
+                                  Segments& segments, const PromisePtr& promise)
+{
+    try
+    {
+        bool success = true;
+        for (auto& segment : segments)
+        {
+            if (!task.send(std::move(segment))())
+            {
+                success = false;
+                break;
+            }
+        }
+        promise->set_value(success);
+    }
+    catch (...)
+    {
+        promise->set_exception(std::current_exception());
+    }
+
+    std::lock_guard<std::mutex> lock(_taggedFramesMutex);
+    --_taggedFrames[frameNumber].pendingSends;
+}
+
+void StreamPrivate::_finishTaggedFrames()
+{
+    for (;;)
+    {
+        // Finish the current frame once all its images have been sent
+        TaggedFrame frame;
+        std::vector<std::pair<Segments, PromisePtr>> nextSends;
+        const auto frameNumber = _sendingFrame;
+        {
+            std::lock_guard<std::mutex> lock(_taggedFramesMutex);
+            const auto it = _taggedFrames.find(frameNumber);
+            if (it == _taggedFrames.end() || !it->second.finished ||
+                it->second.pendingSends > 0)
+            {
+                return;
+            }
+            frame = std::move(it->second);
+            _taggedFrames.erase(it);
+            ++_sendingFrame;
+
+            const auto next = _taggedFrames.find(_sendingFrame);
+            if (next != _taggedFrames.end())
+                nextSends.swap(next->second.heldSends);
+        }
+
+        FrameInfo info;
+        info.frameNumber = frameNumber;
+        info.timestamp = frame.startTime;
+        try
+        {
+            bool success = true;
+            for (auto& finishTask : task.finishFrame(info))
+            {
+                if (!finishTask())
+                {
+                    success = false;
+                    break;
+                }
+            }
+            frame.finished->set_value(success);
+        }
+        catch (...)
+        {
+            frame.finished->set_exception(std::current_exception());
+        }
+
+        for (auto& send : nextSends)
+            _sendSegments(frameNumber + 1, send.first, send.second);
+    }
+}
+
+void StreamPrivate::_queueFrame()
+{
+    // The send policy can be changed by another thread
+    std::unique_lock<std::mutex> lock(_queuedFramesMutex);
+    if (_maxQueuedFrames == 0)
+        return;
+
+    while (_maxQueuedFrames > 0 && _queuedFrames.size() >= _maxQueuedFrames)
+    {
+        if (_sendPolicy == SendPolicy::drop_oldest && _dropOldestFrame())
+            continue;
+        _frameSent.wait(lock);
+    }
+    _currentFrame = std::make_shared<QueuedFrame>();
+    _queuedFrames.push_back(_currentFrame);
+}
+
+bool StreamPrivate::_dropOldestFrame()
+{
+    for (auto it = _queuedFrames.begin(); it != _queuedFrames.end(); ++it)
+    {
+        int state = QueuedFrame::queued;
+        if ((*it)->state.compare_exchange_strong(state, QueuedFrame::dropped))
+        {
+            _queuedFrames.erase(it);
+            statistics.addDroppedFrame();
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamPrivate::_onFrameSent(const QueuedFramePtr& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(_queuedFramesMutex);
+        const auto it =
+            std::find(_queuedFrames.begin(), _queuedFrames.end(), frame);
+        if (it != _queuedFrames.end())
+            _queuedFrames.erase(it);
+    }
+    _frameSent.notify_all();
+}
+
+Task StreamPrivate::_inFrame(Task&& frameTask)
+{
+    return std::move(
+        _inFrame(std::vector<Task>{std::move(frameTask)}, false).front());
+}
+
+std::vector<Task> StreamPrivate::_inFrame(std::vector<Task>&& tasks,
+                                          const bool last)
+{
+    QueuedFramePtr frame;
+    {
+        std::lock_guard<std::mutex> lock(_queuedFramesMutex);
+        frame = _currentFrame;
+        if (last)
+            _currentFrame.reset();
+    }
+    if (!frame)
+        return std::move(tasks);
+
+    auto stream = this;
+    return {[stream, frame, tasks, last]() {
+        // The tasks of a dropped frame are skipped, the others can no longer
+        // be dropped once the frame started to be sent.
+        int state = QueuedFrame::queued;
+        if (!frame->state.compare_exchange_strong(state,
+                                                  QueuedFrame::sending) &&
+            state == QueuedFrame::dropped)
+        {
+            throw FrameDroppedError();
+        }
+
+        // The finish frees the slot of the frame even if the sending failed
+        bool success = true;
+        try
+        {
+            for (const auto& sendTask : tasks)
+            {
+                if (!sendTask())
+                {
+                    success = false;
+                    break;
+                }
+            }
+        }
+        catch (...)
+        {
+            if (last)
+                stream->_onFrameSent(frame);
+            throw;
+        }
+        if (last)
+            stream->_onFrameSent(frame);
+        return success;
+    }};
 }
 
 bool StreamPrivate::_finishFrameDone()
 {
+    statistics.finishFrame(sendWorker.getQueuedRequestCount());
     _pendingFinish = false;
     return true;
 }
@@ -42,16 +42,42 @@
 #ifndef DEFLECT_STREAMPRIVATE_H
 #define DEFLECT_STREAMPRIVATE_H
 
-#include "ImageSegmenter.h"   // member
-#include "Socket.h"           // member
-#include "StreamSendWorker.h" // member
-#include "TaskBuilder.h"      // member
+#include "Event.h"                     // member
+#include "EventReader.h"               // member
+#include "FrameInfo.h"                 // member
+#include "ImageSegmenter.h"            // member
+#include "Socket.h"                    // member
+#include "StreamSendWorker.h"          // member
+#include "StreamStatisticsCollector.h" // member
+#include "TaskBuilder.h"               // member
 
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 
 namespace deflect
 {
+/** A connection to a Server, shared by the streams multiplexed over it. */
+struct StreamConnection
+{
+    /** Create the connection and start its send thread. */
+    StreamConnection(const std::string& host, unsigned short port,
+                     bool connect);
+
+    /** The communication socket instance */
+    Socket socket;
+
+    /** The performance measures of the streams. */
+    StreamStatisticsCollector statistics;
+
+    /** The worker doing all the socket send operations. */
+    StreamSendWorker sendWorker;
+};
+
 /** Private implementation for the Stream class. */
 class StreamPrivate
 {
@@ -63,11 +89,24 @@ public:
      * @param host Address of the target Server instance.
      * @param port Port of the target Server instance.
      * @param observer If the stream is used as a pure observer or not.
+     * @param connectAsync Connect from the send thread instead of blocking.
+     * @param connected Optional callback for the asynchronous connection.
      * @throw std::runtime_error if the connection to server could not be
      *        established.
      */
     StreamPrivate(const std::string& id, const std::string& host,
-                  unsigned short port, bool observer);
+                  unsigned short port, bool observer,
+                  bool connectAsync = false,
+                  std::function<void(bool)> connected = nullptr);
+
+    /**
+     * Create a new stream multiplexed over the connection of another stream.
+     *
+     * @param id the unique stream identifier
+     * @param other the stream whose connection is shared.
+     * @throw std::runtime_error if the stream could not be opened.
+     */
+    StreamPrivate(const std::string& id, StreamPrivate& other);
 
     /** Destructor, close the Stream. */
     ~StreamPrivate();
@@ -75,17 +114,32 @@ public:
     /** The stream identifier. */
     const std::string id;
 
+    /** The connection, shared with the streams multiplexed over it. */
+    std::shared_ptr<StreamConnection> connection;
+
     /** The communication socket instance */
-    Socket socket;
+    Socket& socket;
+
+    /** The performance measures of the connection. */
+    StreamStatisticsCollector& statistics;
+
+    /** The worker doing all the socket send operations. */
+    StreamSendWorker& sendWorker;
+
+    /** Only the stream which opened the connection can receive events. */
+    const bool ownsConnection;
 
     /** Has a successful event registration reply been received */
     bool registeredForEvents = false;
 
+    /** Events received in a batch but not yet returned by getEvent(). */
+    std::deque<Event> pendingEvents;
+
     /** Optional callback when the socket is disconnected. */
     std::function<void()> disconnectedCallback;
 
-    /** The worker doing all the socket send operations. */
-    StreamSendWorker sendWorker;
+    /** Optional thread delivering the received events to a callback. */
+    std::unique_ptr<EventReader> eventReader;
 
     /** Prepare tasks for the sendWorker. */
     TaskBuilder task;
@@ -96,14 +150,91 @@ public:
     /** Remember a pending finishFrame where no sendImage() is allowed. */
     std::atomic_bool _pendingFinish{false};
 
+    /** Sequence number of the last finished frame. */
+    uint64_t _frameNumber = 0;
+
+    /** Time of the first send of the current frame, 0 if none. */
+    int64_t _frameStartTime = 0;
+
     Stream::Future bindEvents(bool exclusive);
     Stream::Future send(const SizeHints& hints);
     Stream::Future send(QByteArray&& data);
     Stream::Future sendImage(const ImageWrapper& image, bool finish);
+    Stream::Future sendImages(const std::vector<ImageWrapper>& images,
+                              bool finish);
+    Stream::Future sendSegment(const Segment& segment);
     Stream::Future sendFinishFrame();
+    Stream::Future sendImage(const ImageWrapper& image, uint64_t frameNumber);
+    Stream::Future sendFinishFrame(uint64_t frameNumber);
+
+    /** Bound the number of frames waiting to be sent, see Stream. */
+    void setSendPolicy(SendPolicy policy, size_t maxQueuedFrames);
+
+    /** Pace the frames with credits granted by the server, see Stream. */
+    bool enableFrameCredits();
+    bool canSendFrame();
 
     /** @internal Called by StreamSendWorker when finishFrame was processed. */
     bool _finishFrameDone();
+
+private:
+    /** A frame waiting to be sent, which can be dropped until it starts. */
+    struct QueuedFrame
+    {
+        enum State
+        {
+            queued,
+            sending,
+            dropped
+        };
+        std::atomic<int> state{queued};
+    };
+    using QueuedFramePtr = std::shared_ptr<QueuedFrame>;
+
+    QMetaObject::Connection _disconnectedConnection;
+    QMetaObject::Connection _streamClosedConnection;
+
+    // Guarded by _queuedFramesMutex, setSendPolicy() may be called by any
+    // thread
+    SendPolicy _sendPolicy = SendPolicy::block;
+    size_t _maxQueuedFrames = 0;
+    std::mutex _queuedFramesMutex;
+    std::condition_variable _frameSent;
+    std::deque<QueuedFramePtr> _queuedFrames;
+    QueuedFramePtr _currentFrame; // null if the send queue is not bounded
+
+    bool _frameCreditsEnabled = false;
+    uint32_t _frameCredits = 0;
+
+    using PromisePtr = std::shared_ptr<std::promise<bool>>;
+
+    /** A frame sent by several threads, see Stream::send(image, frame). */
+    struct TaggedFrame
+    {
+        int64_t startTime = 0;
+        size_t pendingSends = 0;
+        std::vector<std::pair<Segments, PromisePtr>> heldSends;
+        PromisePtr finished;
+    };
+    std::mutex _taggedFramesMutex;
+    std::map<uint64_t, TaggedFrame> _taggedFrames;
+    uint64_t _sendingFrame = 1; // the tagged frame being sent
+
+    void _init();
+    Stream::Future _enqueueControl(Task&& controlTask);
+    void _startFrame();
+    FrameInfo _finishFrame();
+    void _queueFrame();
+    bool _dropOldestFrame();
+    void _onFrameSent(const QueuedFramePtr& frame);
+    void _checkTaggedFrame(uint64_t frameNumber) const;
+    void _sendTagged(uint64_t frameNumber, Segments segments,
+                     PromisePtr promise);
+    void _sendSegments(uint64_t frameNumber, Segments& segments,
+                       const PromisePtr& promise);
+    void _finishTaggedFrames();
+    Task _inFrame(Task&& task);
+    std::vector<Task> _inFrame(std::vector<Task>&& tasks, bool last);
 };
 }
 #endif
@@ -43,14 +43,18 @@
 #include "NetworkProtocol.h"
 #include "Segment.h"
 #include "SizeHints.h"
+#include "Tracer.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace deflect
 {
-StreamSendWorker::StreamSendWorker(Socket& socket, const std::string& id)
+StreamSendWorker::StreamSendWorker(Socket& socket,
+                                   StreamStatisticsCollector& statistics)
     : _socket(socket)
-    , _id(id)
+    , _statistics(statistics)
+    , _currentStream(_streams.end())
     , _dequeuedRequests(std::thread::hardware_concurrency() / 2)
 {
 }
@@ -76,6 +80,8 @@ void StreamSendWorker::stop()
         if (request.promise)
             request.promise->set_value(false);
     }
+    while (_controlRequests.try_dequeue(request))
+        request.promise->set_value(false);
 }
 
 void StreamSendWorker::run()
@@ -87,7 +93,7 @@ void StreamSendWorker::run()
             break;
 
         size_t count = 0;
-        if (!_pendingFinish)
+        if (_finishRequests.empty())
             count = _requests.wait_dequeue_bulk(_dequeuedRequests.begin(),
                                                 _dequeuedRequests.size());
         else
@@ -97,18 +103,25 @@ void StreamSendWorker::run()
             count = _requests.try_dequeue_bulk(_dequeuedRequests.begin(),
                                                _dequeuedRequests.size());
 
-            // no more pending sends, now process the finish request and reset
-            // for next finish
+            // no more pending sends, now process the finish requests (one for
+            // each of the multiplexed streams) and reset for next finish
             if (count == 0)
             {
-                count = 1;
-                _finishRequest.isFinish = false; // reset this to process this
-                                                 // request now
-                _dequeuedRequests[0] = _finishRequest;
-                _pendingFinish = false;
+                count = std::min(_finishRequests.size(),
+                                 _dequeuedRequests.size());
+                for (size_t i = 0; i < count; ++i)
+                {
+                    // reset this to process this request now
+                    _finishRequests[i].isFinish = false;
+                    _dequeuedRequests[i] = std::move(_finishRequests[i]);
+                }
+                _finishRequests.erase(_finishRequests.begin(),
+                                      _finishRequests.begin() + count);
             }
         }
 
+        _processControlRequests();
+
         for (size_t i = 0; i < count; ++i)
         {
             auto& request = _dequeuedRequests[i];
@@ -117,43 +130,58 @@ void StreamSendWorker::run()
             // does not guarantee order)
             if (request.isFinish)
             {
-                if (_pendingFinish)
-                {
-                    if (request.promise)
-                        request.promise->set_exception(std::make_exception_ptr(
-                            std::runtime_error("Already have pending finish")));
-                    continue;
-                }
-
-                _finishRequest = request;
-                _pendingFinish = true;
+                _finishRequests.push_back(std::move(request));
                 continue;
             }
 
-            try
-            {
-                bool success = true;
-                for (auto& task : request.tasks)
-                {
-                    if (!task())
-                    {
-                        success = false;
-                        break;
-                    }
-                }
+            _process(request);
+        }
+    }
+}
 
-                if (request.promise)
-                    request.promise->set_value(success);
-            }
-            catch (...)
+void StreamSendWorker::_process(Request& request)
+{
+    const TraceScope trace{"client", "processRequest"};
+    try
+    {
+        bool success = true;
+        for (auto& task : request.tasks)
+        {
+            if (!task())
             {
-                if (request.promise)
-                    request.promise->set_exception(std::current_exception());
+                success = false;
+                break;
             }
         }
+
+        if (request.promise)
+            request.promise->set_value(success);
+    }
+    catch (...)
+    {
+        if (request.promise)
+            request.promise->set_exception(std::current_exception());
+    }
+    if (request.promise)
+    {
+        _statistics.addRequestLatency(StreamStatisticsCollector::Clock::now() -
+                                      request.time);
     }
 }
 
+void StreamSendWorker::_processControlRequests()
+{
+    if (_controlRequests.size_approx() == 0)
+        return;
+
+    // Also called between the segments of an image being sent
+    const auto currentStream = _currentStream;
+    Request request;
+    while (_controlRequests.try_dequeue(request))
+        _process(request);
+    _currentStream = currentStream;
+}
+
 Stream::Future StreamSendWorker::enqueueRequest(Task&& action, bool isFinish)
 {
     return enqueueRequest(std::vector<Task>{std::move(action)}, isFinish);
@@ -164,39 +192,108 @@ Stream::Future StreamSendWorker::enqueueRequest(std::vector<Task>&& tasks,
 {
     auto promise = std::make_shared<Promise>();
     auto future = promise->get_future();
-    _requests.enqueue({std::move(promise), std::move(tasks), isFinish});
+    _requests.enqueue({std::move(promise), std::move(tasks), isFinish,
+                       StreamStatisticsCollector::Clock::now()});
+    return future;
+}
+
+Stream::Future StreamSendWorker::enqueueControlRequest(Task&& task)
+{
+    auto promise = std::make_shared<Promise>();
+    auto future = promise->get_future();
+    Request request{std::move(promise), std::vector<Task>{std::move(task)},
+                    false, StreamStatisticsCollector::Clock::now()};
+    _controlRequests.enqueue(std::move(request));
+
+    // Wake up the worker if it is waiting for requests
+    _requests.enqueue({nullptr, std::vector<Task>(), false,
+                       StreamStatisticsCollector::Clock::time_point()});
     return future;
 }
 
 void StreamSendWorker::enqueueFastRequest(Task&& task)
 {
-    _requests.enqueue({nullptr, std::vector<Task>{std::move(task)}, false});
+    _requests.enqueue({nullptr, std::vector<Task>{std::move(task)}, false,
+                       StreamStatisticsCollector::Clock::time_point()});
+}
+
+size_t StreamSendWorker::getQueuedRequestCount() const
+{
+    return _requests.size_approx();
+}
+
+void StreamSendWorker::_selectStream(const std::string& id)
+{
+    if (_currentStream != _streams.end() && _currentStream->first == id)
+        return;
+
+    _currentStream = _streams.find(id);
+    if (_currentStream == _streams.end())
+        _currentStream = _streams.emplace(id, StreamState()).first;
+}
+
+bool StreamSendWorker::_connect(const bool observer)
+{
+    try
+    {
+        _socket.connectToHost();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "deflect::Stream: " << e.what() << std::endl;
+        return false;
+    }
+    return observer ? _sendOpenObserver() : _sendOpenStream();
 }
 
 bool StreamSendWorker::_sendOpenObserver()
 {
+    _currentStream->second.opened = true;
     return _send(MESSAGE_TYPE_OBSERVER_OPEN,
                  QByteArray::number(NETWORK_PROTOCOL_VERSION));
 }
 
 bool StreamSendWorker::_sendOpenStream()
 {
+    _currentStream->second.opened = true;
     return _send(MESSAGE_TYPE_PIXELSTREAM_OPEN,
                  QByteArray::number(NETWORK_PROTOCOL_VERSION));
 }
 
+bool StreamSendWorker::_sendOpenMultiplexedStream()
+{
+    if (!_socket.isConnected())
+        return false;
+
+    if (_socket.getServerProtocolVersion() < MULTIPLEXING_PROTOCOL_VERSION)
+        throw std::runtime_error("Server does not support multiplexing");
+
+    if (_currentStream->second.opened)
+        throw std::runtime_error("Stream id already used by the connection");
+
+    return _sendOpenStream();
+}
+
 bool StreamSendWorker::_sendClose()
 {
-    return _send(MESSAGE_TYPE_QUIT, {});
+    const auto success = _send(MESSAGE_TYPE_QUIT, {});
+    _socket.removeStream(_currentStream->first);
+    _streams.erase(_currentStream);
+    _currentStream = _streams.end();
+    return success;
 }
 
 bool StreamSendWorker::_sendSegment(const Segment& segment)
 {
-    if (segment.view != _currentView)
+    // Control messages preempt the remaining segments of the current frame
+    _processControlRequests();
+
+    auto& stream = _currentStream->second;
+    if (segment.view != stream.view)
     {
         if (!_sendImageView(segment.view))
             return false;
-        _currentView = segment.view;
+        stream.view = segment.view;
     }
     _sendRowOrderIfChanged(segment.rowOrder);
     _sendImageChannelIfChanged(segment.channel);
@@ -204,6 +301,11 @@ bool StreamSendWorker::_sendSegment(const Segment& segment)
     auto message = QByteArray{(const char*)(&segment.parameters),
                               sizeof(SegmentParameters)};
     message.append(segment.imageData);
+
+    const auto rawBytes = size_t(segment.parameters.width) *
+                          segment.parameters.height * 4; // RGBA
+    _statistics.addSentSegment(rawBytes, segment.imageData.size());
+
     return _send(MESSAGE_TYPE_PIXELSTREAM, message, false);
 }
 
@@ -215,11 +317,12 @@ bool StreamSendWorker::_sendImageView(const View view)
 
 bool StreamSendWorker::_sendRowOrderIfChanged(const RowOrder rowOrder)
 {
-    if (rowOrder != _currentRowOrder)
+    auto& stream = _currentStream->second;
+    if (rowOrder != stream.rowOrder)
     {
         if (!_sendImageRowOrder(rowOrder))
             return false;
-        _currentRowOrder = rowOrder;
+        stream.rowOrder = rowOrder;
     }
     return true;
 }
@@ -232,11 +335,12 @@ bool StreamSendWorker::_sendImageRowOrder(const RowOrder rowOrder)
 
 bool StreamSendWorker::_sendImageChannelIfChanged(const uint8_t channel)
 {
-    if (channel != _currentChannel)
+    auto& stream = _currentStream->second;
+    if (channel != stream.channel)
     {
         if (!_sendImageChannel(channel))
             return false;
-        _currentChannel = channel;
+        stream.channel = channel;
     }
     return true;
 }
@@ -247,9 +351,14 @@ bool StreamSendWorker::_sendImageChannel(const uint8_t channel)
                  QByteArray{(const char*)(&channel), sizeof(uint8_t)});
 }
 
-bool StreamSendWorker::_sendFinish()
+bool StreamSendWorker::_sendFinish(const FrameInfo& info)
 {
-    return _send(MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME, {});
+    // Older servers expect an empty message
+    if (_socket.getServerProtocolVersion() < FRAME_INFO_PROTOCOL_VERSION)
+        return _send(MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME, {});
+
+    return _send(MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME,
+                 QByteArray{(const char*)(&info), sizeof(FrameInfo)});
 }
 
 bool StreamSendWorker::_sendData(const QByteArray data)
@@ -270,10 +379,25 @@ bool StreamSendWorker::_sendBindEvents(const bool exclusive)
                  {});
 }
 
+bool StreamSendWorker::_sendEnableFrameCredits()
+{
+    if (_socket.getServerProtocolVersion() < FRAME_CREDIT_PROTOCOL_VERSION)
+        return false;
+
+    return _send(MESSAGE_TYPE_ENABLE_FRAME_CREDITS, {});
+}
+
 bool StreamSendWorker::_send(const MessageType type, const QByteArray& message,
                              const bool waitForBytesWritten)
 {
-    return _socket.send(MessageHeader(type, message.size(), _id), message,
-                        waitForBytesWritten);
+    const auto start = StreamStatisticsCollector::Clock::now();
+    // The id in the header tags the message with its multiplexed stream
+    const auto& id = _currentStream->first;
+    if (_socket.isStreamClosed(id))
+        return false;
+    const auto success = _socket.send(MessageHeader(type, message.size(), id),
+                                      message, waitForBytesWritten);
+    _statistics.addSocketTime(StreamStatisticsCollector::Clock::now() - start);
+    return success;
 }
 }
@@ -41,9 +41,11 @@
 #ifndef DEFLECT_STREAMSENDWORKER_H
 #define DEFLECT_STREAMSENDWORKER_H
 
-#include "MessageHeader.h" // MessageType
-#include "Socket.h"        // member
-#include "Stream.h"        // Stream::Future
+#include "FrameInfo.h"                 // FrameInfo
+#include "MessageHeader.h"             // MessageType
+#include "Socket.h"                    // member
+#include "Stream.h"                    // Stream::Future
+#include "StreamStatisticsCollector.h" // member
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -56,6 +58,8 @@
 
 #include <QThread>
 
+#include <map>
+
 namespace deflect
 {
 using Task = std::function<bool()>;
@@ -68,12 +72,19 @@ using Task = std::function<bool()>;
  * "QSocketNotifier: Socket notifiers cannot be enabled or disabled from another
  * thread".
  * To avoid it, the Socket must be moved to the worker thread (moveToThread()).
+ *
+ * Several streams can be multiplexed over the socket: each task selects the
+ * stream its messages are tagged with, see TaskBuilder.
+ *
+ * Control requests have their own queue, which is processed before the other
+ * requests and between the segments of an image. They are not delayed by the
+ * compression and transmission of large frames.
  */
 class StreamSendWorker : public QThread
 {
 public:
     /** Create a new stream worker associated to an existing socket. */
-    StreamSendWorker(Socket& socket, const std::string& id);
+    StreamSendWorker(Socket& socket, StreamStatisticsCollector& statistics);
 
     /** Stop and destroy the worker. */
     ~StreamSendWorker();
@@ -85,9 +96,20 @@ public:
     Stream::Future enqueueRequest(std::vector<Task>&& actions,
                                   bool isFinish = false);
 
+    /**
+     * Enqueue a request to be sent before the pending images.
+     *
+     * It is sent at the next message boundary, even between the segments of
+     * an image. The order is only kept among the control requests.
+     */
+    Stream::Future enqueueControlRequest(Task&& task);
+
     /** Enqueue a request with no future to check for its completion. */
     void enqueueFastRequest(Task&& task);
 
+    /** @return the approximate number of requests waiting to be processed. */
+    size_t getQueuedRequestCount() const;
+
 private:
     using Promise = std::promise<bool>;
     using PromisePtr = std::shared_ptr<Promise>;
@@ -97,20 +119,31 @@ private:
         PromisePtr promise;
         std::vector<Task> tasks;
         bool isFinish;
+        StreamStatisticsCollector::Clock::time_point time;
     };
 
+    /** The state of the messages sent for one of the streams. */
+    struct StreamState
+    {
+        bool opened = false;
+        View view = View::mono;
+        RowOrder rowOrder = RowOrder::top_down;
+        uint8_t channel = 0;
+    };
+    using Streams = std::map<std::string, StreamState>;
+
     Socket& _socket;
-    const std::string& _id;
+    StreamStatisticsCollector& _statistics;
 
     moodycamel::BlockingConcurrentQueue<Request> _requests;
+    moodycamel::ConcurrentQueue<Request> _controlRequests;
     std::atomic_bool _running{false};
-    View _currentView = View::mono;
-    RowOrder _currentRowOrder = RowOrder::top_down;
-    uint8_t _currentChannel = 0;
+
+    Streams _streams;
+    Streams::iterator _currentStream;
 
     std::vector<Request> _dequeuedRequests;
-    bool _pendingFinish = false;
-    Request _finishRequest;
+    std::vector<Request> _finishRequests; // at most one per stream
 
     /** Stop the worker and clear any pending send tasks. */
     void stop();
@@ -118,11 +151,17 @@ private:
     /** Main QThread loop doing asynchronous processing of queued tasks. */
     void run() final;
 
-    friend class deflect::test::Application; // to send pre-compressed segments
+    void _process(Request& request);
+    void _processControlRequests();
+
     friend class TaskBuilder;
 
+    void _selectStream(const std::string& id);
+
+    bool _connect(bool observer);
     bool _sendOpenObserver();
     bool _sendOpenStream();
+    bool _sendOpenMultiplexedStream();
     bool _sendClose();
     bool _sendSegment(const Segment& segment);
     bool _sendImageView(View view);
@@ -130,10 +169,11 @@ private:
     bool _sendImageRowOrder(RowOrder rowOrder);
     bool _sendImageChannelIfChanged(uint8_t channel);
     bool _sendImageChannel(uint8_t channel);
-    bool _sendFinish();
+    bool _sendFinish(const FrameInfo& info);
     bool _sendData(const QByteArray data);
     bool _sendSizeHints(const SizeHints& hints);
     bool _sendBindEvents(const bool exclusive);
+    bool _sendEnableFrameCredits();
 
     bool _send(MessageType type, const QByteArray& message,
                bool waitForBytesWritten = true);
@@ -0,0 +1,96 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_STREAMSTATISTICS_H
+#define DEFLECT_STREAMSTATISTICS_H
+
+#include <deflect/types.h>
+
+namespace deflect
+{
+/**
+ * Performance statistics of a Stream.
+ *
+ * The measures are computed over a rolling window of the most recent frames or
+ * requests, see Stream::getStatistics(). Times are given in milliseconds.
+ */
+struct StreamStatistics
+{
+    /** Summary of a measure over the rolling window. */
+    struct Measure
+    {
+        double mean = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        size_t samples = 0; //!< Number of samples in the window
+    };
+
+    /** @name Encoding, per frame */
+    //@{
+    /** Wall time from the segmentation to the last compressed segment. */
+    Measure encodeTime;
+    /** Compression time of each thread, averaged over the threads. */
+    Measure compressionTimePerThread;
+    /** Number of threads which compressed the segments. */
+    Measure compressionThreads;
+    //@}
+
+    /** @name Data size, over the window */
+    //@{
+    uint64_t rawBytes = 0;        //!< Uncompressed size of the sent segments
+    uint64_t compressedBytes = 0; //!< Size of the sent segments
+    double compressionRatio = 1.0; //!< rawBytes / compressedBytes
+    //@}
+
+    /** @name Sending */
+    //@{
+    /** Time from a send call to the completion of its future, per request. */
+    Measure sendLatency;
+    /** Time blocked writing to the socket, per frame. */
+    Measure socketTime;
+    /** Requests waiting in the send queue, sampled at the end of frames. */
+    Measure queuedRequests;
+    //@}
+
+    size_t frames = 0; //!< Number of frames finished since the stream opened
+    size_t droppedFrames = 0; //!< Frames dropped by SendPolicy::drop_oldest
+};
+}
+
+#endif
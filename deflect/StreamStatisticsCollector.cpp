@@ -0,0 +1,204 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "StreamStatisticsCollector.h"
+
+#include <algorithm>
+
+namespace deflect
+{
+namespace
+{
+double _toMilliseconds(const StreamStatisticsCollector::Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+}
+
+StreamStatisticsCollector::Window::Window(const size_t size)
+    : _samples(std::max(size, size_t(1)))
+{
+}
+
+void StreamStatisticsCollector::Window::push(const double value)
+{
+    _samples[_next] = value;
+    _next = (_next + 1) % _samples.size();
+    _count = std::min(_count + 1, _samples.size());
+}
+
+StreamStatistics::Measure StreamStatisticsCollector::Window::summarize() const
+{
+    StreamStatistics::Measure measure;
+    if (_count == 0)
+        return measure;
+
+    const auto begin = _samples.begin();
+    const auto end = begin + _count;
+    const auto minmax = std::minmax_element(begin, end);
+    measure.min = *minmax.first;
+    measure.max = *minmax.second;
+    measure.mean = sum() / _count;
+    measure.samples = _count;
+    return measure;
+}
+
+double StreamStatisticsCollector::Window::sum() const
+{
+    double total = 0.0;
+    for (size_t i = 0; i < _count; ++i)
+        total += _samples[i];
+    return total;
+}
+
+StreamStatisticsCollector::StreamStatisticsCollector(const size_t windowSize)
+    : _encodeTime{windowSize}
+    , _compressionTimePerThread{windowSize}
+    , _compressionThreads{windowSize}
+    , _rawBytesPerFrame{windowSize}
+    , _sentBytesPerFrame{windowSize}
+    , _sendLatency{windowSize}
+    , _socketTimePerFrame{windowSize}
+    , _queuedRequests{windowSize}
+{
+}
+
+void StreamStatisticsCollector::beginEncoding()
+{
+    const auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_encoding)
+    {
+        _encoding = true;
+        _encodingStart = now;
+        _encodingEnd = now;
+    }
+}
+
+void StreamStatisticsCollector::addSegmentEncoding(
+    const Clock::time_point start, const Clock::time_point end)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_encoding)
+    {
+        _encoding = true;
+        _encodingStart = start;
+    }
+    _encodingEnd = std::max(_encodingEnd, end);
+    _threadTimes[std::this_thread::get_id()] += end - start;
+}
+
+void StreamStatisticsCollector::addSentSegment(const size_t rawBytes,
+                                               const size_t sentBytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _rawBytes += rawBytes;
+    _sentBytes += sentBytes;
+}
+
+void StreamStatisticsCollector::addSocketTime(const Clock::duration duration)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _socketTime += duration;
+}
+
+void StreamStatisticsCollector::addRequestLatency(
+    const Clock::duration duration)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sendLatency.push(_toMilliseconds(duration));
+}
+
+void StreamStatisticsCollector::finishFrame(const size_t queuedRequests)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_encoding)
+    {
+        _encodeTime.push(_toMilliseconds(_encodingEnd - _encodingStart));
+
+        if (!_threadTimes.empty())
+        {
+            Clock::duration total{0};
+            for (const auto& kv : _threadTimes)
+                total += kv.second;
+            const auto threads = _threadTimes.size();
+            _compressionTimePerThread.push(_toMilliseconds(total) / threads);
+            _compressionThreads.push(threads);
+        }
+    }
+    _rawBytesPerFrame.push(_rawBytes);
+    _sentBytesPerFrame.push(_sentBytes);
+    _socketTimePerFrame.push(_toMilliseconds(_socketTime));
+    _queuedRequests.push(queuedRequests);
+    ++_frames;
+
+    _encoding = false;
+    _threadTimes.clear();
+    _socketTime = Clock::duration{0};
+    _rawBytes = 0;
+    _sentBytes = 0;
+}
+
+void StreamStatisticsCollector::addDroppedFrame()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_droppedFrames;
+}
+
+StreamStatistics StreamStatisticsCollector::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    StreamStatistics stats;
+    stats.encodeTime = _encodeTime.summarize();
+    stats.compressionTimePerThread = _compressionTimePerThread.summarize();
+    stats.compressionThreads = _compressionThreads.summarize();
+    stats.rawBytes = _rawBytesPerFrame.sum();
+    stats.compressedBytes = _sentBytesPerFrame.sum();
+    if (stats.compressedBytes > 0)
+        stats.compressionRatio = double(stats.rawBytes) / stats.compressedBytes;
+    stats.sendLatency = _sendLatency.summarize();
+    stats.socketTime = _socketTimePerFrame.summarize();
+    stats.queuedRequests = _queuedRequests.summarize();
+    stats.frames = _frames;
+    stats.droppedFrames = _droppedFrames;
+    return stats;
+}
+}
@@ -0,0 +1,139 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_STREAMSTATISTICSCOLLECTOR_H
+#define DEFLECT_STREAMSTATISTICSCOLLECTOR_H
+
+#include <deflect/StreamStatistics.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace deflect
+{
+/**
+ * Collect the performance measures of a Stream.
+ *
+ * The measures are reported by the caller, compression and send threads and
+ * accumulated until the end of each frame, when they are added to rolling
+ * windows of the most recent frames.
+ *
+ * @threadsafe
+ */
+class StreamStatisticsCollector
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @param windowSize the number of samples in the rolling windows. */
+    explicit StreamStatisticsCollector(size_t windowSize = 100);
+
+    /** Mark the start of the encoding of an image for the current frame. */
+    void beginEncoding();
+
+    /** Add the encoding of one segment by the calling thread. */
+    void addSegmentEncoding(Clock::time_point start, Clock::time_point end);
+
+    /** Add a segment sent to the socket. */
+    void addSentSegment(size_t rawBytes, size_t sentBytes);
+
+    /** Add the time spent writing to the socket. */
+    void addSocketTime(Clock::duration duration);
+
+    /** Add the time between a send call and the completion of its future. */
+    void addRequestLatency(Clock::duration duration);
+
+    /**
+     * Finish the current frame.
+     * @param queuedRequests the number of requests waiting to be sent
+     */
+    void finishFrame(size_t queuedRequests);
+
+    /** Add a frame dropped before being sent. */
+    void addDroppedFrame();
+
+    /** @return the statistics over the rolling windows. */
+    StreamStatistics getStatistics() const;
+
+private:
+    /** Ring of the most recent samples of a measure. */
+    class Window
+    {
+    public:
+        explicit Window(size_t size);
+        void push(double value);
+        StreamStatistics::Measure summarize() const;
+        double sum() const;
+
+    private:
+        std::vector<double> _samples;
+        size_t _next = 0;
+        size_t _count = 0;
+    };
+
+    mutable std::mutex _mutex;
+
+    /** @name Accumulators for the current frame */
+    //@{
+    Clock::time_point _encodingStart;
+    Clock::time_point _encodingEnd;
+    bool _encoding = false;
+    std::map<std::thread::id, Clock::duration> _threadTimes;
+    Clock::duration _socketTime{0};
+    uint64_t _rawBytes = 0;
+    uint64_t _sentBytes = 0;
+    //@}
+
+    Window _encodeTime;
+    Window _compressionTimePerThread;
+    Window _compressionThreads;
+    Window _rawBytesPerFrame;
+    Window _sentBytesPerFrame;
+    Window _sendLatency;
+    Window _socketTimePerFrame;
+    Window _queuedRequests;
+    size_t _frames = 0;
+    size_t _droppedFrames = 0;
+};
+}
+
+#endif
@@ -51,62 +51,104 @@ TaskBuilder::TaskBuilder(StreamSendWorker* worker, StreamPrivate* stream)
 {
 }
 
+Task TaskBuilder::connect(const bool observer,
+                          std::function<void(bool)> callback)
+{
+    auto worker = _worker;
+    return _forStream([worker, observer, callback] {
+        const auto success = worker->_connect(observer);
+        if (callback)
+            callback(success);
+        return success;
+    });
+}
+
 Task TaskBuilder::openStream()
 {
-    return std::bind(&StreamSendWorker::_sendOpenStream, _worker);
+    return _forStream(std::bind(&StreamSendWorker::_sendOpenStream, _worker));
+}
+
+Task TaskBuilder::openMultiplexedStream()
+{
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendOpenMultiplexedStream, _worker));
 }
 
 Task TaskBuilder::close()
 {
-    return std::bind(&StreamSendWorker::_sendClose, _worker);
+    return _forStream(std::bind(&StreamSendWorker::_sendClose, _worker));
 }
 
 Task TaskBuilder::openObserver()
 {
-    return std::bind(&StreamSendWorker::_sendOpenObserver, _worker);
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendOpenObserver, _worker));
 }
 
 Task TaskBuilder::bindEvents(const bool exclusive)
 {
-    return std::bind(&StreamSendWorker::_sendBindEvents, _worker, exclusive);
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendBindEvents, _worker, exclusive));
+}
+
+Task TaskBuilder::enableFrameCredits()
+{
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendEnableFrameCredits, _worker));
 }
 
 Task TaskBuilder::send(const SizeHints& hints)
 {
-    return std::bind(&StreamSendWorker::_sendSizeHints, _worker, hints);
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendSizeHints, _worker, hints));
 }
 
 Task TaskBuilder::send(const QByteArray& data)
 {
-    return std::bind(&StreamSendWorker::_sendData, _worker, data);
+    return _forStream(std::bind(&StreamSendWorker::_sendData, _worker, data));
 }
 
 std::vector<Task> TaskBuilder::sendUsingMTCompression(
     const ImageWrapper& image, ImageSegmenter& imageSegmenter,
-    const bool finish)
+    const bool finish, const FrameInfo& info)
+{
+    return _withFinish(send(image, imageSegmenter), finish, info);
+}
+
+std::vector<Task> TaskBuilder::sendUsingMTCompression(
+    const std::vector<ImageWrapper>& images, ImageSegmenter& imageSegmenter,
+    const bool finish, const FrameInfo& info)
+{
+    return _withFinish(send(images, imageSegmenter), finish, info);
+}
+
+std::vector<Task> TaskBuilder::_withFinish(Task&& sendTask, const bool finish,
+                                           const FrameInfo& info)
 {
     std::vector<Task> tasks;
-    tasks.emplace_back(send(image, imageSegmenter));
+    tasks.emplace_back(std::move(sendTask));
     if (finish)
     {
-        auto finishTasks = finishFrame();
+        auto finishTasks = finishFrame(info);
         tasks.insert(tasks.end(), std::make_move_iterator(finishTasks.begin()),
                      std::make_move_iterator(finishTasks.end()));
     }
     return tasks;
 }
 
-std::vector<Task> TaskBuilder::finishFrame()
+std::vector<Task> TaskBuilder::finishFrame(const FrameInfo& info)
 {
     std::vector<Task> tasks;
-    tasks.emplace_back(std::bind(&StreamSendWorker::_sendFinish, _worker));
+    tasks.emplace_back(
+        _forStream(std::bind(&StreamSendWorker::_sendFinish, _worker, info)));
     tasks.emplace_back(std::bind(&StreamPrivate::_finishFrameDone, _stream));
     return tasks;
 }
 
 Task TaskBuilder::send(Segment&& segment)
 {
-    return std::bind(&StreamSendWorker::_sendSegment, _worker, segment);
+    return _forStream(
+        std::bind(&StreamSendWorker::_sendSegment, _worker, segment));
 }
 
 Task TaskBuilder::send(const ImageWrapper& image,
@@ -114,8 +156,28 @@ Task TaskBuilder::send(const ImageWrapper& image,
 {
     auto sendFunc = std::bind(&StreamSendWorker::_sendSegment, _worker,
                               std::placeholders::_1);
-    return [&imageSegmenter, image, sendFunc]() {
+    return _forStream([&imageSegmenter, image, sendFunc]() {
         return imageSegmenter.generate(image, sendFunc);
+    });
+}
+
+Task TaskBuilder::send(const std::vector<ImageWrapper>& images,
+                       ImageSegmenter& imageSegmenter)
+{
+    auto sendFunc = std::bind(&StreamSendWorker::_sendSegment, _worker,
+                              std::placeholders::_1);
+    return _forStream([&imageSegmenter, images, sendFunc]() {
+        return imageSegmenter.generate(images, sendFunc);
+    });
+}
+
+Task TaskBuilder::_forStream(Task task) const
+{
+    auto worker = _worker;
+    const auto& id = _stream->id;
+    return [worker, &id, task] {
+        worker->_selectStream(id);
+        return task();
     };
 }
 }
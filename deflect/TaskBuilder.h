@@ -40,6 +40,7 @@
 #ifndef DEFLECT_TASKBUILDER_H
 #define DEFLECT_TASKBUILDER_H
 
+#include "FrameInfo.h"
 #include "StreamSendWorker.h"
 #include "types.h"
 
@@ -47,15 +48,21 @@ namespace deflect
 {
 /**
  * Create tasks to be executed asynchrounously by the StreamSendWorker.
+ *
+ * The tasks send their messages on behalf of the stream given at construction,
+ * which may share the worker with other multiplexed streams.
  */
 class TaskBuilder
 {
 public:
     TaskBuilder(StreamSendWorker* worker, StreamPrivate* stream);
 
+    Task connect(bool observer, std::function<void(bool)> callback);
     Task openStream();
+    Task openMultiplexedStream();
     Task openObserver();
     Task bindEvents(bool exclusive);
+    Task enableFrameCredits();
     Task close();
 
     Task send(const SizeHints& hints);
@@ -63,14 +70,25 @@ public:
     Task send(Segment&& segment);
     std::vector<Task> sendUsingMTCompression(const ImageWrapper& image,
                                              ImageSegmenter& imageSegmenter,
-                                             bool finish);
-    std::vector<Task> finishFrame();
+                                             bool finish,
+                                             const FrameInfo& info);
+    std::vector<Task> sendUsingMTCompression(
+        const std::vector<ImageWrapper>& images,
+        ImageSegmenter& imageSegmenter, bool finish, const FrameInfo& info);
+    std::vector<Task> finishFrame(const FrameInfo& info);
 
 private:
     StreamSendWorker* _worker = nullptr;
     StreamPrivate* _stream = nullptr;
 
     Task send(const ImageWrapper& image, ImageSegmenter& imageSegmenter);
+    Task send(const std::vector<ImageWrapper>& images,
+              ImageSegmenter& imageSegmenter);
+    std::vector<Task> _withFinish(Task&& sendTask, bool finish,
+                                  const FrameInfo& info);
+
+    /** @return the task, selecting the stream of this builder first. */
+    Task _forStream(Task task) const;
 };
 }
 
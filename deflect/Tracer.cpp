@@ -0,0 +1,166 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "Tracer.h"
+
+#include <QCoreApplication>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+const char* TRACE_FILE_ENV_VAR = "DEFLECT_TRACE_FILE";
+const size_t EVENTS_FLUSH_THRESHOLD = 4096;
+
+std::atomic<int> nextThreadId{1};
+
+int64_t _microseconds(const deflect::Tracer::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+        .count();
+}
+}
+
+namespace deflect
+{
+/** Events buffered by one thread, flushed when full and at thread exit. */
+struct Tracer::ThreadEvents
+{
+    ThreadEvents() { events.reserve(EVENTS_FLUSH_THRESHOLD); }
+    ~ThreadEvents() { flush(); }
+    void flush()
+    {
+        if (events.empty())
+            return;
+        if (auto tracer = Tracer::get())
+            tracer->_write(events, threadId);
+        events.clear();
+    }
+
+    const int threadId = nextThreadId++;
+    std::vector<Event> events;
+};
+
+thread_local std::unique_ptr<Tracer::ThreadEvents> Tracer::_threadEvents;
+
+Tracer::Tracer(const std::string& filename)
+    : _startTime{Clock::now()}
+    , _processId{QCoreApplication::applicationPid()}
+    , _file{filename, std::ios::out | std::ios::trunc}
+{
+    if (_file)
+        _file << "[";
+}
+
+Tracer* Tracer::get()
+{
+    static Tracer* tracer = _create();
+    return tracer;
+}
+
+Tracer* Tracer::_create()
+{
+    const auto filename = qgetenv(TRACE_FILE_ENV_VAR);
+    if (filename.isEmpty())
+        return nullptr;
+
+    // Intentionally never deleted: threads may still record events during
+    // static destruction, they are discarded once the file is closed.
+    auto tracer = new Tracer(filename.toStdString());
+    if (!tracer->_file)
+    {
+        std::cerr << "deflect::Tracer: could not open trace file: "
+                  << filename.constData() << std::endl;
+        delete tracer;
+        return nullptr;
+    }
+    std::atexit([] {
+        if (_threadEvents)
+            _threadEvents->flush();
+        Tracer::get()->_close();
+    });
+    return tracer;
+}
+
+void Tracer::addEvent(const char* category, const char* name,
+                      const Clock::time_point start,
+                      const Clock::time_point end)
+{
+    if (!_threadEvents)
+        _threadEvents.reset(new ThreadEvents);
+
+    _threadEvents->events.push_back({category, name,
+                                    _microseconds(start - _startTime),
+                                    _microseconds(end - start)});
+    if (_threadEvents->events.size() >= EVENTS_FLUSH_THRESHOLD)
+        _threadEvents->flush();
+}
+
+void Tracer::_write(const std::vector<Event>& events, const int threadId)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed)
+        return;
+
+    for (const auto& event : events)
+    {
+        _file << (_firstEvent ? "\n" : ",\n");
+        _firstEvent = false;
+        _file << "{\"name\":\"" << event.name << "\",\"cat\":\""
+              << event.category << "\",\"ph\":\"X\",\"ts\":" << event.start
+              << ",\"dur\":" << event.duration << ",\"pid\":" << _processId
+              << ",\"tid\":" << threadId << "}";
+    }
+    _file.flush();
+}
+
+void Tracer::_close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_closed)
+        return;
+
+    _file << "\n]\n";
+    _file.close();
+    _closed = true;
+}
+}
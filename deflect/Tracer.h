@@ -0,0 +1,150 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_TRACER_H
+#define DEFLECT_TRACER_H
+
+#include <deflect/api.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace deflect
+{
+/**
+ * Record timeline events of the client and server hot paths to a file in the
+ * Chrome trace event format (JSON array), which can be opened with
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Tracing is opt-in: it is enabled by setting the DEFLECT_TRACE_FILE
+ * environment variable to the path of the output file. When it is not set,
+ * get() returns nullptr and recording an event costs a single test.
+ *
+ * Events are buffered per thread and written to the file in batches, so
+ * tracing does not serialize the threads being observed. The file is
+ * completed at process exit.
+ */
+class Tracer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** @return the process tracer, or nullptr if tracing is disabled. */
+    DEFLECT_API static Tracer* get();
+
+    /**
+     * Record a complete event for the calling thread.
+     *
+     * @param category of the event, must be a string literal.
+     * @param name of the event, must be a string literal.
+     * @param start time of the event.
+     * @param end time of the event.
+     */
+    DEFLECT_API void addEvent(const char* category, const char* name,
+                              Clock::time_point start, Clock::time_point end);
+
+private:
+    struct Event
+    {
+        const char* category;
+        const char* name;
+        int64_t start;
+        int64_t duration;
+    };
+    struct ThreadEvents;
+    static thread_local std::unique_ptr<ThreadEvents> _threadEvents;
+
+    explicit Tracer(const std::string& filename);
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static Tracer* _create();
+
+    void _write(const std::vector<Event>& events, int threadId);
+    void _close();
+
+    const Clock::time_point _startTime;
+    const int64_t _processId;
+
+    std::mutex _mutex;
+    std::ofstream _file;
+    bool _firstEvent = true;
+    bool _closed = false;
+};
+
+/**
+ * Record the lifetime of a scope as a trace event if tracing is enabled.
+ *
+ * Usage: const TraceScope trace{"server", "dispatchFrame"};
+ */
+class TraceScope
+{
+public:
+    TraceScope(const char* category, const char* name)
+        : _tracer{Tracer::get()}
+        , _category{category}
+        , _name{name}
+    {
+        if (_tracer)
+            _start = Tracer::Clock::now();
+    }
+
+    ~TraceScope()
+    {
+        if (_tracer)
+            _tracer->addEvent(_category, _name, _start, Tracer::Clock::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    Tracer* const _tracer;
+    const char* const _category;
+    const char* const _name;
+    Tracer::Clock::time_point _start;
+};
+}
+
+#endif
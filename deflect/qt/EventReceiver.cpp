@@ -49,21 +49,17 @@ namespace qt
 EventReceiver::EventReceiver(Stream& stream)
     : QObject()
     , _stream(stream)
-    , _notifier(
-          new QSocketNotifier(_stream.getDescriptor(), QSocketNotifier::Read))
-    , _timer(new QTimer)
 {
-    connect(_notifier.get(), &QSocketNotifier::activated, this,
-            &EventReceiver::_onEvent);
-
-    // QSocketNotifier sometimes does not fire, help with a timer
-    connect(_timer.get(), &QTimer::timeout,
-            [this] { _onEvent(_stream.getDescriptor()); });
-    _timer->start(1);
+    // Events are pushed from the stream's reader thread
+    connect(this, &EventReceiver::_eventReceived, this,
+            &EventReceiver::_onEvent, Qt::QueuedConnection);
+    _stream.setEventCallback(
+        [this](const Event event) { emit _eventReceived(event); });
 }
 
 EventReceiver::~EventReceiver()
 {
+    _stream.setEventCallback(nullptr);
 }
 
 inline QPointF _pos(const Event& deflectEvent)
@@ -71,78 +67,69 @@ inline QPointF _pos(const Event& deflectEvent)
     return QPointF{deflectEvent.mouseX, deflectEvent.mouseY};
 }
 
-void EventReceiver::_onEvent(const int socket)
+void EventReceiver::_onEvent(const Event& deflectEvent)
 {
-    if (socket != _stream.getDescriptor())
+    if (_stopped)
         return;
 
-    while (_stream.hasEvent())
+    switch (deflectEvent.type)
     {
-        const Event& deflectEvent = _stream.getEvent();
-
-        switch (deflectEvent.type)
-        {
-        case Event::EVT_CLOSE:
-            _stop();
-            return;
-        case Event::EVT_PRESS:
-            emit pressed(_pos(deflectEvent));
-            break;
-        case Event::EVT_RELEASE:
-            emit released(_pos(deflectEvent));
-            break;
-        case Event::EVT_MOVE:
-            emit moved(_pos(deflectEvent));
-            break;
-        case Event::EVT_VIEW_SIZE_CHANGED:
-            emit resized(QSize{int(deflectEvent.dx), int(deflectEvent.dy)});
-            break;
-        case Event::EVT_SWIPE_LEFT:
-            emit swipeLeft();
-            break;
-        case Event::EVT_SWIPE_RIGHT:
-            emit swipeRight();
-            break;
-        case Event::EVT_SWIPE_UP:
-            emit swipeUp();
-            break;
-        case Event::EVT_SWIPE_DOWN:
-            emit swipeDown();
-            break;
-        case Event::EVT_KEY_PRESS:
-            emit keyPress(deflectEvent.key, deflectEvent.modifiers,
-                          QString::fromStdString(deflectEvent.text));
-            break;
-        case Event::EVT_KEY_RELEASE:
-            emit keyRelease(deflectEvent.key, deflectEvent.modifiers,
-                            QString::fromStdString(deflectEvent.text));
-            break;
-        case Event::EVT_TOUCH_ADD:
-            emit touchPointAdded(deflectEvent.key, _pos(deflectEvent));
-            break;
-        case Event::EVT_TOUCH_UPDATE:
-            emit touchPointUpdated(deflectEvent.key, _pos(deflectEvent));
-            break;
-        case Event::EVT_TOUCH_REMOVE:
-            emit touchPointRemoved(deflectEvent.key, _pos(deflectEvent));
-            break;
-        case Event::EVT_CLICK:
-        case Event::EVT_DOUBLECLICK:
-        case Event::EVT_PINCH:
-        case Event::EVT_WHEEL:
-        default:
-            break;
-        }
-    }
-
-    if (!_stream.isConnected())
+    case Event::EVT_CLOSE:
         _stop();
+        return;
+    case Event::EVT_PRESS:
+        emit pressed(_pos(deflectEvent));
+        break;
+    case Event::EVT_RELEASE:
+        emit released(_pos(deflectEvent));
+        break;
+    case Event::EVT_MOVE:
+        emit moved(_pos(deflectEvent));
+        break;
+    case Event::EVT_VIEW_SIZE_CHANGED:
+        emit resized(QSize{int(deflectEvent.dx), int(deflectEvent.dy)});
+        break;
+    case Event::EVT_SWIPE_LEFT:
+        emit swipeLeft();
+        break;
+    case Event::EVT_SWIPE_RIGHT:
+        emit swipeRight();
+        break;
+    case Event::EVT_SWIPE_UP:
+        emit swipeUp();
+        break;
+    case Event::EVT_SWIPE_DOWN:
+        emit swipeDown();
+        break;
+    case Event::EVT_KEY_PRESS:
+        emit keyPress(deflectEvent.key, deflectEvent.modifiers,
+                      QString::fromStdString(deflectEvent.text));
+        break;
+    case Event::EVT_KEY_RELEASE:
+        emit keyRelease(deflectEvent.key, deflectEvent.modifiers,
+                        QString::fromStdString(deflectEvent.text));
+        break;
+    case Event::EVT_TOUCH_ADD:
+        emit touchPointAdded(deflectEvent.key, _pos(deflectEvent));
+        break;
+    case Event::EVT_TOUCH_UPDATE:
+        emit touchPointUpdated(deflectEvent.key, _pos(deflectEvent));
+        break;
+    case Event::EVT_TOUCH_REMOVE:
+        emit touchPointRemoved(deflectEvent.key, _pos(deflectEvent));
+        break;
+    case Event::EVT_CLICK:
+    case Event::EVT_DOUBLECLICK:
+    case Event::EVT_PINCH:
+    case Event::EVT_WHEEL:
+    default:
+        break;
+    }
 }
 
 void EventReceiver::_stop()
 {
-    _notifier->setEnabled(false);
-    _timer->stop();
+    _stopped = true;
     emit closed();
 }
 }
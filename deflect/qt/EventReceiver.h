@@ -44,8 +44,6 @@
 #include <QObject>
 #include <QPointF>
 #include <QSize>
-#include <QSocketNotifier>
-#include <QTimer>
 
 #include <deflect/Stream.h>
 
@@ -81,12 +79,14 @@ signals:
     void touchPointUpdated(int id, QPointF position);
     void touchPointRemoved(int id, QPointF position);
 
+    /** @internal */
+    void _eventReceived(deflect::Event event);
+
 private:
     Stream& _stream;
-    std::unique_ptr<QSocketNotifier> _notifier;
-    std::unique_ptr<QTimer> _timer;
+    bool _stopped = false;
 
-    void _onEvent(int socket);
+    void _onEvent(const Event& deflectEvent);
     void _stop();
 };
 }
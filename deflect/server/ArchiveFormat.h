@@ -0,0 +1,100 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_ARCHIVEFORMAT_H
+#define DEFLECT_SERVER_ARCHIVEFORMAT_H
+
+#include <cstdint>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Binary layout of the frame archives written by the FrameRecorder.
+ *
+ * An archive is made of two append-only files in native byte order:
+ * - the data file: a FileHeader, followed by one record per frame made of a
+ *   FrameHeader, the stream uri and, for each tile, a TileHeader followed by
+ *   the tile's image data.
+ * - the index file (data file name + ".index"): the offset of each frame
+ *   record in the data file, as uint64_t, written only once the record itself
+ *   has been written.
+ */
+namespace archive
+{
+const char magic[8] = {'D', 'E', 'F', 'L', 'E', 'C', 'T', 'A'};
+const uint32_t version = 1;
+const char* const indexSuffix = ".index";
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct FrameHeader
+{
+    uint64_t timestamp; //!< Microseconds since the start of the recording
+    uint32_t tileCount;
+    uint32_t uriSize; //!< Size in bytes of the UTF-8 uri which follows
+};
+
+struct TileHeader
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t dataSize; //!< Size in bytes of the image data which follows
+    uint8_t format;
+    uint8_t rowOrder;
+    uint8_t view;
+    uint8_t channel;
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected FileHeader padding");
+static_assert(sizeof(FrameHeader) == 16, "unexpected FrameHeader padding");
+static_assert(sizeof(TileHeader) == 24, "unexpected TileHeader padding");
+}
+}
+}
+
+#endif
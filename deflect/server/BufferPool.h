@@ -0,0 +1,182 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_BUFFERPOOL_H
+#define DEFLECT_SERVER_BUFFERPOOL_H
+
+#include <QByteArray>
+
+#include <map>
+#include <mutex>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Pool of reusable byte buffers for the received and decoded tile data.
+ *
+ * Buffers are explicitly given back with release() by the code which last
+ * used them (e.g. once a received tile has been decoded, or once a dispatched
+ * frame is destroyed). The pool never holds
+ * a copy of a buffer in use, so its owner can modify it without a deep copy.
+ *
+ * The buffers kept for reuse are bounded by a total number of bytes. When the
+ * budget is reached, the smaller buffers make room for the larger ones, so
+ * that the buffers which are too small for the current tiles do not hold the
+ * budget. The buffers which have not been reused for a while are freed.
+ *
+ * Thread safe.
+ */
+class BufferPool
+{
+public:
+    /**
+     * @param maxBytes the maximum number of bytes kept for reuse.
+     * @param maxIdleAcquires the number of acquire() calls after which a
+     *        buffer which has not been reused is freed.
+     */
+    explicit BufferPool(const size_t maxBytes = 16 * 1024 * 1024,
+                        const size_t maxIdleAcquires = 256)
+        : _maxBytes{maxBytes}
+        , _maxIdleAcquires{maxIdleAcquires}
+    {
+    }
+
+    /**
+     * Get a buffer of the given size, reusing a released one if possible.
+     *
+     * The buffer content is uninitialized.
+     */
+    QByteArray acquire(const int size)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (++_acquires % _maxIdleAcquires == 0)
+            _freeIdleBuffers();
+
+        const auto it = _buffers.lower_bound(size);
+        if (it == _buffers.end())
+            return QByteArray(size, Qt::Uninitialized);
+
+        auto buffer = std::move(it->second.buffer);
+        _erase(it);
+        buffer.resize(size);
+        return buffer;
+    }
+
+    /**
+     * Give back a buffer for reuse.
+     *
+     * The buffer is only kept if this is its last copy and it fits in the
+     * byte budget of the pool, possibly by freeing smaller buffers.
+     */
+    void release(QByteArray&& buffer)
+    {
+        const auto capacity = size_t(buffer.capacity());
+        if (capacity == 0 || capacity > _maxBytes || !buffer.isDetached())
+            return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (_byteCount + capacity > _maxBytes && !_buffers.empty() &&
+               size_t(_buffers.begin()->first) < capacity)
+        {
+            _erase(_buffers.begin());
+        }
+        if (_byteCount + capacity > _maxBytes)
+            return;
+
+        _byteCount += capacity;
+        _buffers.emplace(buffer.capacity(), Entry{std::move(buffer), _epoch});
+    }
+
+    /** @return the number of buffers currently kept for reuse. */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _buffers.size();
+    }
+
+    /** @return the number of bytes currently kept for reuse. */
+    size_t byteCount() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _byteCount;
+    }
+
+private:
+    struct Entry
+    {
+        QByteArray buffer;
+        size_t epoch; // of the release, see _freeIdleBuffers()
+    };
+    using Buffers = std::multimap<int, Entry>; // by capacity
+
+    const size_t _maxBytes;
+    const size_t _maxIdleAcquires;
+
+    mutable std::mutex _mutex;
+    Buffers _buffers;
+    size_t _byteCount = 0;
+    size_t _acquires = 0;
+    size_t _epoch = 0;
+
+    /** Free the buffers released before the previous period. */
+    void _freeIdleBuffers()
+    {
+        for (auto it = _buffers.begin(); it != _buffers.end();)
+        {
+            if (it->second.epoch < _epoch)
+                it = _erase(it);
+            else
+                ++it;
+        }
+        ++_epoch;
+    }
+
+    Buffers::iterator _erase(const Buffers::iterator it)
+    {
+        _byteCount -= size_t(it->first);
+        return _buffers.erase(it);
+    }
+};
+}
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_CLOCKOFFSET_H
+#define DEFLECT_SERVER_CLOCKOFFSET_H
+
+#include <array>
+#include <cstdint>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Estimate of the offset between the clock of a client and the server's.
+ *
+ * The server sends timestamped pings which the client answers with its own
+ * time, in the manner of NTP. Assuming symmetric network delays, each round
+ * trip measures the offset with an error of at most half its duration. The
+ * estimate is the offset measured by the fastest of the recent round trips,
+ * which is the least affected by queuing in the network or in the client.
+ *
+ * All the times are in microseconds.
+ */
+class ClockOffset
+{
+public:
+    /** The number of recent round trips among which the fastest is used. */
+    static const size_t sampleCount = 8;
+
+    /**
+     * Add the measurement of a round trip.
+     *
+     * @param sendTime The server time at which the ping was sent
+     * @param clientTime The client time at which the ping was answered
+     * @param receiveTime The server time at which the answer was received
+     */
+    void addRoundTrip(const int64_t sendTime, const int64_t clientTime,
+                      const int64_t receiveTime)
+    {
+        if (receiveTime < sendTime)
+            return;
+
+        auto& sample = _samples[_next];
+        sample.roundTripTime = receiveTime - sendTime;
+        sample.offset = clientTime - (sendTime + sample.roundTripTime / 2);
+        _next = (_next + 1) % sampleCount;
+        if (_count < sampleCount)
+            ++_count;
+
+        _best = 0;
+        for (size_t i = 1; i < _count; ++i)
+        {
+            if (_samples[i].roundTripTime < _samples[_best].roundTripTime)
+                _best = i;
+        }
+    }
+
+    /** @return true if at least one round trip was measured. */
+    bool isValid() const { return _count > 0; }
+
+    /** @return the client time minus the server time, 0 if unknown. */
+    int64_t getOffset() const { return _count ? _samples[_best].offset : 0; }
+
+    /** @return the duration of the round trip which measured the offset. */
+    int64_t getRoundTripTime() const
+    {
+        return _count ? _samples[_best].roundTripTime : 0;
+    }
+
+    /** @return the given client time converted to the server clock. */
+    int64_t toServerTime(const int64_t clientTime) const
+    {
+        return clientTime - getOffset();
+    }
+
+private:
+    struct Sample
+    {
+        int64_t offset = 0;
+        int64_t roundTripTime = 0;
+    };
+    std::array<Sample, sampleCount> _samples;
+    size_t _count = 0;
+    size_t _next = 0;
+    size_t _best = 0;
+};
+}
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_EVENTQUEUE_H
+#define DEFLECT_SERVER_EVENTQUEUE_H
+
+#include <deflect/Event.h>
+
+#include <vector>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Queue of the events waiting to be sent to an observer.
+ *
+ * Consecutive EVT_MOVE events, and consecutive EVT_TOUCH_UPDATE events of the
+ * same touch point, are coalesced into the most recent one with the sum of
+ * their deltas. Events of other pointers in between do not prevent coalescing,
+ * but any other event of the same pointer does, so the order in which an
+ * observer sees the events of each pointer is preserved.
+ *
+ * Not thread safe.
+ */
+class EventQueue
+{
+public:
+    /** Add an event, coalescing it with a pending one if possible. */
+    void push(const Event& event)
+    {
+        if (_isCoalescable(event))
+        {
+            for (auto it = _events.rbegin(); it != _events.rend(); ++it)
+            {
+                if (!_isSamePointer(*it, event))
+                    continue;
+                if (it->type != event.type)
+                    break;
+
+                const auto dx = it->dx + event.dx;
+                const auto dy = it->dy + event.dy;
+                *it = event;
+                it->dx = dx;
+                it->dy = dy;
+                return;
+            }
+        }
+        _events.push_back(event);
+    }
+
+    /** @return the pending events in order, leaving the queue empty. */
+    std::vector<Event> takeAll()
+    {
+        std::vector<Event> events;
+        events.swap(_events);
+        return events;
+    }
+
+    /** @return true if no event is pending. */
+    bool empty() const { return _events.empty(); }
+
+    /** @return the number of pending events. */
+    size_t size() const { return _events.size(); }
+
+private:
+    std::vector<Event> _events;
+
+    static bool _isCoalescable(const Event& event)
+    {
+        return event.type == Event::EVT_MOVE ||
+               event.type == Event::EVT_TOUCH_UPDATE;
+    }
+
+    static bool _isTouchPoint(const Event& event)
+    {
+        return event.type == Event::EVT_TOUCH_ADD ||
+               event.type == Event::EVT_TOUCH_UPDATE ||
+               event.type == Event::EVT_TOUCH_REMOVE;
+    }
+
+    // Touch point events are ordered per point id; all other events are
+    // conservatively considered to concern the same (mouse) pointer.
+    static bool _isSamePointer(const Event& a, const Event& b)
+    {
+        if (_isTouchPoint(a) != _isTouchPoint(b))
+            return false;
+        return !_isTouchPoint(a) || a.key == b.key;
+    }
+};
+}
+}
+
+#endif
@@ -52,6 +52,29 @@ namespace deflect
 {
 namespace server
 {
+/**
+ * Identity and timestamps of a frame along the streaming pipeline.
+ *
+ * The timestamps are in microseconds since the epoch, 0 if unknown. The send
+ * time is given by the clock of the client, converted to the server's once
+ * the offset between the clocks has been estimated (clients using network
+ * protocol version 13 or later). The others are given by the server's clock.
+ */
+struct FrameTrace
+{
+    /** Sequence number of the frame sent by the client(s), 0 if unknown. */
+    uint64_t frameNumber = 0;
+
+    /** Time at which the client(s) started sending the frame. */
+    int64_t sendTime = 0;
+
+    /** Time at which the frame was finished by all the sources. */
+    int64_t receiveTime = 0;
+
+    /** Time at which the frame was dispatched to the application. */
+    int64_t dispatchTime = 0;
+};
+
 /**
  * A frame for a PixelStream.
  */
@@ -63,6 +86,15 @@ struct Frame
     /** The PixelStream uri to which this frame is associated. */
     QString uri;
 
+    /**
+     * The identity and timestamps of the frame.
+     *
+     * The frame number and send time are only available for clients using
+     * network protocol version 9 or later. For streams with multiple sources,
+     * they are the lowest ones among the sources.
+     */
+    FrameTrace trace;
+
     /** @return the total dimensions of the given channel of this frame. */
     DEFLECT_API QSize computeDimensions(const uint8_t channel = 0) const;
 
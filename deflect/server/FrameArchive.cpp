@@ -0,0 +1,213 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "FrameArchive.h"
+
+#include "ArchiveFormat.h"
+#include "Frame.h"
+
+#include <QFile>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace deflect
+{
+namespace server
+{
+class FrameArchive::Impl
+{
+public:
+    Impl(const QString& filename)
+        : file{filename}
+    {
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            throw std::runtime_error("could not open archive file: " +
+                                     filename.toStdString());
+        }
+        size = file.size();
+        if (size > 0)
+            data = file.map(0, size);
+        if (!data || size < qint64(sizeof(archive::FileHeader)))
+            throw std::runtime_error("invalid archive file");
+
+        archive::FileHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, archive::magic, sizeof(header.magic)))
+            throw std::runtime_error("invalid archive file");
+        if (header.version != archive::version)
+            throw std::runtime_error("unsupported archive version");
+
+        readIndex(filename + archive::indexSuffix);
+        scanFrames();
+    }
+
+    void readIndex(const QString& filename)
+    {
+        QFile indexFile(filename);
+        if (!indexFile.open(QIODevice::ReadOnly))
+            return;
+
+        const auto index = indexFile.readAll();
+        const auto count = index.size() / sizeof(uint64_t);
+        offsets.resize(count);
+        std::memcpy(offsets.data(), index.constData(),
+                    count * sizeof(uint64_t));
+
+        // Only keep the entries which refer to complete frames
+        while (!offsets.empty() && getFrameEnd(offsets.back()) < 0)
+            offsets.pop_back();
+    }
+
+    void scanFrames()
+    {
+        qint64 offset = sizeof(archive::FileHeader);
+        if (!offsets.empty())
+            offset = getFrameEnd(offsets.back());
+
+        qint64 end = 0;
+        while ((end = getFrameEnd(offset)) > 0)
+        {
+            offsets.push_back(offset);
+            offset = end;
+        }
+    }
+
+    /** @return the end of a frame record, or -1 if it is incomplete. */
+    qint64 getFrameEnd(qint64 offset) const
+    {
+        archive::FrameHeader frameHeader;
+        if (!read(offset, frameHeader))
+            return -1;
+        offset += sizeof(frameHeader) + frameHeader.uriSize;
+
+        for (uint32_t i = 0; i < frameHeader.tileCount; ++i)
+        {
+            archive::TileHeader tileHeader;
+            if (!read(offset, tileHeader))
+                return -1;
+            offset += sizeof(tileHeader) + tileHeader.dataSize;
+        }
+        return offset <= size ? offset : -1;
+    }
+
+    template <typename T>
+    bool read(const qint64 offset, T& value) const
+    {
+        if (offset < 0 || offset + qint64(sizeof(T)) > size)
+            return false;
+        std::memcpy(&value, data + offset, sizeof(T));
+        return true;
+    }
+
+    QFile file;
+    qint64 size = 0;
+    const uchar* data = nullptr;
+    std::vector<uint64_t> offsets;
+};
+
+FrameArchive::FrameArchive(const QString& filename)
+    : _impl(new Impl(filename))
+{
+}
+
+FrameArchive::~FrameArchive()
+{
+}
+
+size_t FrameArchive::getFrameCount() const
+{
+    return _impl->offsets.size();
+}
+
+uint64_t FrameArchive::getTimestamp(const size_t index) const
+{
+    archive::FrameHeader frameHeader;
+    _impl->read(_impl->offsets.at(index), frameHeader);
+    return frameHeader.timestamp;
+}
+
+QString FrameArchive::getUri(const size_t index) const
+{
+    const auto offset = _impl->offsets.at(index);
+    const auto data = reinterpret_cast<const char*>(_impl->data);
+
+    archive::FrameHeader frameHeader;
+    _impl->read(offset, frameHeader);
+    return QString::fromUtf8(data + offset + sizeof(frameHeader),
+                             frameHeader.uriSize);
+}
+
+FramePtr FrameArchive::getFrame(const size_t index) const
+{
+    qint64 offset = _impl->offsets.at(index);
+    const auto data = reinterpret_cast<const char*>(_impl->data);
+
+    archive::FrameHeader frameHeader;
+    _impl->read(offset, frameHeader);
+    offset += sizeof(frameHeader);
+
+    auto frame = std::make_shared<Frame>();
+    frame->uri = QString::fromUtf8(data + offset, frameHeader.uriSize);
+    offset += frameHeader.uriSize;
+
+    frame->tiles.resize(frameHeader.tileCount);
+    for (auto& tile : frame->tiles)
+    {
+        archive::TileHeader tileHeader;
+        _impl->read(offset, tileHeader);
+        offset += sizeof(tileHeader);
+
+        tile.x = tileHeader.x;
+        tile.y = tileHeader.y;
+        tile.width = tileHeader.width;
+        tile.height = tileHeader.height;
+        tile.format = Format(tileHeader.format);
+        tile.rowOrder = RowOrder(tileHeader.rowOrder);
+        tile.view = View(tileHeader.view);
+        tile.channel = tileHeader.channel;
+        tile.imageData = QByteArray(data + offset, tileHeader.dataSize);
+        offset += tileHeader.dataSize;
+    }
+    return frame;
+}
+}
+}
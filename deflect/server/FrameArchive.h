@@ -0,0 +1,115 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_FRAMEARCHIVE_H
+#define DEFLECT_SERVER_FRAMEARCHIVE_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QString>
+
+#include <memory>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Random access to the frames of an archive written by the FrameRecorder.
+ *
+ * The archive is memory-mapped; frames are only parsed when requested.
+ */
+class FrameArchive
+{
+public:
+    /**
+     * Open an archive.
+     *
+     * If the index file is missing or incomplete, the frames are indexed by
+     * scanning the data file. A truncated last frame is ignored.
+     *
+     * @param filename The archive data file.
+     * @throw std::runtime_error if the file could not be opened or is not a
+     *        valid archive.
+     */
+    DEFLECT_API explicit FrameArchive(const QString& filename);
+
+    /** Close the archive. */
+    DEFLECT_API ~FrameArchive();
+
+    /** @return the number of frames in the archive. */
+    DEFLECT_API size_t getFrameCount() const;
+
+    /**
+     * @param index The index of the frame, in [0, getFrameCount()[
+     * @return the time at which the frame was recorded, in microseconds since
+     *         the start of the recording.
+     * @throw std::out_of_range if the index is invalid.
+     */
+    DEFLECT_API uint64_t getTimestamp(size_t index) const;
+
+    /**
+     * @param index The index of the frame, in [0, getFrameCount()[
+     * @return the uri of the stream to which the frame belongs, without
+     *         reading its tiles.
+     * @throw std::out_of_range if the index is invalid.
+     */
+    DEFLECT_API QString getUri(size_t index) const;
+
+    /**
+     * Read a frame.
+     *
+     * @param index The index of the frame, in [0, getFrameCount()[
+     * @return the frame, with a copy of the tiles' image data.
+     * @throw std::out_of_range if the index is invalid.
+     */
+    DEFLECT_API FramePtr getFrame(size_t index) const;
+
+private:
+    FrameArchive(const FrameArchive&) = delete;
+    const FrameArchive& operator=(const FrameArchive&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+};
+}
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "FrameAssembler.h"
+
+#include "Frame.h"
+#include "deflect/defines.h"
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include "TileDecoder.h"
+#endif
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace deflect
+{
+namespace server
+{
+namespace
+{
+const int bytesPerPixel = 4;
+
+struct TileJob
+{
+    const Tile* tile;
+    uint8_t* dest; // top-left pixel of the tile in the image
+    int pitch;
+    std::string* error;
+};
+
+void _copyTile(const Tile& tile, uint8_t* dest, const int pitch)
+{
+    const auto rowSize = tile.width * bytesPerPixel;
+    if (size_t(tile.imageData.size()) != rowSize * tile.height)
+        throw std::runtime_error("unexpected tile size");
+
+    const auto src = tile.imageData.constData();
+    for (uint32_t y = 0; y < tile.height; ++y)
+        std::memcpy(dest + y * pitch, src + y * rowSize, rowSize);
+}
+
+void _writeTile(const TileJob& job)
+{
+    switch (job.tile->format)
+    {
+    case Format::rgba:
+        _copyTile(*job.tile, job.dest, job.pitch);
+        break;
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    case Format::jpeg:
+    {
+        // One decoder (and libjpeg-turbo handle) per thread of the pool
+        thread_local TileDecoder decoder;
+        decoder.decode(*job.tile, job.dest, job.pitch);
+        break;
+    }
+#endif
+    default:
+        throw std::runtime_error("unsupported tile format for assembly");
+    }
+}
+
+void _assembleTile(const TileJob& job)
+{
+    try
+    {
+        _writeTile(job);
+    }
+    catch (const std::runtime_error& e)
+    {
+        *job.error = e.what();
+    }
+}
+
+void _flipRows(FrameAssembler::Image& image)
+{
+    const auto pitch = image.size.width() * bytesPerPixel;
+    const auto height = image.size.height();
+    auto data = reinterpret_cast<uint8_t*>(image.data.data());
+
+    std::vector<int> rows(height / 2);
+    for (size_t i = 0; i < rows.size(); ++i)
+        rows[i] = i;
+
+    QtConcurrent::blockingMap(rows, [data, pitch, height](const int row) {
+        std::swap_ranges(data + row * pitch, data + (row + 1) * pitch,
+                         data + (height - 1 - row) * pitch);
+    });
+}
+}
+
+class FrameAssembler::Impl
+{
+public:
+    RowOrder rowOrder = RowOrder::top_down;
+    Images images;
+
+    Image* findImage(const View view, const uint8_t channel)
+    {
+        for (auto& image : images)
+        {
+            if (image.view == view && image.channel == channel)
+                return &image;
+        }
+        return nullptr;
+    }
+
+    void prepareImages(const Frame& frame, const RowOrder frameRowOrder)
+    {
+        const auto sizes = frame.computeChannelDimensions();
+
+        // Reuse the buffers of the previous frame if the sizes are unchanged
+        Images previousImages;
+        previousImages.swap(images);
+
+        for (const auto& tile : frame.tiles)
+        {
+            if (findImage(tile.view, tile.channel))
+                continue;
+
+            Image image;
+            image.view = tile.view;
+            image.channel = tile.channel;
+            image.size = sizes.at(tile.channel);
+            image.rowOrder = frameRowOrder;
+            for (auto& previous : previousImages)
+            {
+                if (previous.view == image.view &&
+                    previous.channel == image.channel &&
+                    previous.size == image.size)
+                {
+                    image.data.swap(previous.data);
+                    break;
+                }
+            }
+            const int byteCount =
+                image.size.width() * image.size.height() * bytesPerPixel;
+            if (image.data.size() != byteCount)
+                image.data = QByteArray(byteCount, 0);
+            images.push_back(std::move(image));
+        }
+    }
+};
+
+FrameAssembler::FrameAssembler()
+    : _impl(new Impl)
+{
+}
+
+FrameAssembler::~FrameAssembler()
+{
+}
+
+void FrameAssembler::setRowOrder(const RowOrder rowOrder)
+{
+    _impl->rowOrder = rowOrder;
+}
+
+RowOrder FrameAssembler::getRowOrder() const
+{
+    return _impl->rowOrder;
+}
+
+const FrameAssembler::Images& FrameAssembler::assemble(const Frame& frame)
+{
+    if (frame.tiles.empty())
+    {
+        _impl->images.clear();
+        return _impl->images;
+    }
+
+    const auto frameRowOrder = frame.determineRowOrder();
+    _impl->prepareImages(frame, frameRowOrder);
+
+    // Get the image pointers first, data() may detach from a copy held by the
+    // application.
+    std::map<const Image*, uint8_t*> imageData;
+    for (auto& image : _impl->images)
+        imageData[&image] = reinterpret_cast<uint8_t*>(image.data.data());
+
+    std::vector<std::string> errors(frame.tiles.size());
+    std::vector<TileJob> jobs;
+    jobs.reserve(frame.tiles.size());
+    for (size_t i = 0; i < frame.tiles.size(); ++i)
+    {
+        const auto& tile = frame.tiles[i];
+        const auto image = _impl->findImage(tile.view, tile.channel);
+        const auto pitch = image->size.width() * bytesPerPixel;
+
+        // The positions of bottom_up tiles have been mirrored by the Server,
+        // but their rows are still stored bottom-up.
+        const auto row = frameRowOrder == RowOrder::bottom_up
+                             ? image->size.height() - tile.y - tile.height
+                             : tile.y;
+        const auto dest =
+            imageData[image] + row * pitch + tile.x * bytesPerPixel;
+        jobs.emplace_back(TileJob{&tile, dest, pitch, &errors[i]});
+    }
+    QtConcurrent::blockingMap(jobs, _assembleTile);
+
+    for (const auto& error : errors)
+    {
+        if (!error.empty())
+            throw std::runtime_error("frame assembly failed: " + error);
+    }
+
+    for (auto& image : _impl->images)
+    {
+        if (image.rowOrder != _impl->rowOrder)
+        {
+            _flipRows(image);
+            image.rowOrder = _impl->rowOrder;
+        }
+    }
+    return _impl->images;
+}
+
+const FrameAssembler::Image& FrameAssembler::getImage(
+    const View view, const uint8_t channel) const
+{
+    if (const auto image = _impl->findImage(view, channel))
+        return *image;
+    throw std::out_of_range("no image for this view and channel");
+}
+}
+}
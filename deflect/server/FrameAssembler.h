@@ -0,0 +1,127 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_FRAMEASSEMBLER_H
+#define DEFLECT_SERVER_FRAMEASSEMBLER_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QByteArray>
+#include <QSize>
+
+#include <memory>
+#include <vector>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Compose the tiles of a Frame into contiguous RGBA images.
+ *
+ * One image is produced for each view and channel of the frame. JPEG tiles are
+ * decoded directly into their location in the images and RGBA tiles are
+ * copied, both in parallel. The images are reused from one frame to the next
+ * as long as their dimensions do not change.
+ */
+class FrameAssembler
+{
+public:
+    /** An assembled image for one view and channel of a Frame. */
+    struct Image
+    {
+        View view = View::mono;
+        uint8_t channel = 0;
+        QSize size;
+        RowOrder rowOrder = RowOrder::top_down;
+        QByteArray data; //!< RGBA pixels, size.width() * 4 bytes per row
+    };
+    using Images = std::vector<Image>;
+
+    /** Construct a frame assembler. */
+    DEFLECT_API FrameAssembler();
+
+    /** Destruct the frame assembler. */
+    DEFLECT_API ~FrameAssembler();
+
+    /**
+     * Set the row order of the assembled images.
+     *
+     * The rows are flipped if the frame has a different row order.
+     *
+     * @param rowOrder The row order of the images, top_down by default.
+     */
+    DEFLECT_API void setRowOrder(RowOrder rowOrder);
+
+    /** @return the row order of the assembled images. */
+    DEFLECT_API RowOrder getRowOrder() const;
+
+    /**
+     * Assemble all the tiles of a frame.
+     *
+     * The frame is not modified, its JPEG tiles are decoded on the fly.
+     *
+     * @param frame The frame to assemble, as dispatched by the Server.
+     * @return the images for each view and channel of the frame, which remain
+     *         valid until the next call.
+     * @throw std::runtime_error if a tile could not be decoded or is in a YUV
+     *        format, or if the frame has incoherent row orders.
+     */
+    DEFLECT_API const Images& assemble(const Frame& frame);
+
+    /**
+     * Get the image of a view and channel of the last assembled frame.
+     *
+     * @throw std::out_of_range if the last frame has no such image.
+     */
+    DEFLECT_API const Image& getImage(View view = View::mono,
+                                      uint8_t channel = 0) const;
+
+private:
+    FrameAssembler(const FrameAssembler&) = delete;
+    const FrameAssembler& operator=(const FrameAssembler&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+};
+}
+}
+
+#endif
@@ -39,10 +39,131 @@
 
 #include "FrameDispatcher.h"
 
+#include "BufferPool.h"
 #include "Frame.h"
+#include "FrameRecorder.h"
 #include "ReceiveBuffer.h"
 
+#include "deflect/FrameInfo.h"
+#include "deflect/Tracer.h"
+
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <mutex>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const size_t maxSpareTileLists = 4;
+
+/**
+ * Create frames which give their buffers back for reuse once destroyed.
+ *
+ * The image data of the tiles is released to the BufferPool (which only keeps
+ * it if it is no longer shared) and the list of tiles is kept to receive a
+ * following frame. The frames can be destroyed from any thread.
+ */
+class FrameRecycler : public std::enable_shared_from_this<FrameRecycler>
+{
+public:
+    explicit FrameRecycler(std::shared_ptr<deflect::server::BufferPool> pool)
+        : _pool{std::move(pool)}
+    {
+    }
+
+    deflect::server::FramePtr makeFrame()
+    {
+        auto frame = new deflect::server::Frame;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_spareTiles.empty())
+            {
+                frame->tiles = std::move(_spareTiles.back());
+                _spareTiles.pop_back();
+            }
+        }
+        auto recycler = shared_from_this();
+        auto deleter = [recycler](deflect::server::Frame* frame_) {
+            recycler->_recycle(frame_);
+        };
+        return deflect::server::FramePtr{frame, deleter};
+    }
+
+private:
+    const std::shared_ptr<deflect::server::BufferPool> _pool;
+    std::mutex _mutex;
+    std::vector<deflect::server::Tiles> _spareTiles;
+
+    void _recycle(deflect::server::Frame* frame)
+    {
+        auto& tiles = frame->tiles;
+        if (_pool)
+        {
+            for (auto& tile : tiles)
+                _pool->release(std::move(tile.imageData));
+        }
+        tiles.clear(); // keeps capacity for reuse
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_spareTiles.size() < maxSpareTileLists)
+                _spareTiles.push_back(std::move(tiles));
+        }
+        delete frame;
+    }
+};
+
+double _rate(const uint64_t current, const uint64_t previous,
+             const double seconds)
+{
+    // counters of a removed source disappear from the totals of the stream
+    if (current <= previous || seconds <= 0.0)
+        return 0.0;
+    return (current - previous) / seconds;
+}
+
+void _computeRates(deflect::server::SourceStatistics& stats,
+                   const deflect::server::SourceStatistics& previous,
+                   const double seconds)
+{
+    stats.bytesPerSecond =
+        _rate(stats.receivedBytes, previous.receivedBytes, seconds);
+    stats.tilesPerSecond =
+        _rate(stats.receivedTiles, previous.receivedTiles, seconds);
+    stats.framesPerSecond =
+        _rate(stats.receivedFrames, previous.receivedFrames, seconds);
+}
+
+void _computeRates(deflect::server::StreamStatistics& stats,
+                   const deflect::server::StreamStatistics& previous,
+                   const double seconds)
+{
+    stats.bytesPerSecond =
+        _rate(stats.receivedBytes, previous.receivedBytes, seconds);
+    stats.tilesPerSecond =
+        _rate(stats.receivedTiles, previous.receivedTiles, seconds);
+    stats.completeFramesPerSecond =
+        _rate(stats.completeFrames, previous.completeFrames, seconds);
+    stats.dispatchedFramesPerSecond =
+        _rate(stats.dispatchedFrames, previous.dispatchedFrames, seconds);
+    stats.droppedFramesPerSecond =
+        _rate(stats.droppedFrames, previous.droppedFrames, seconds);
+
+    for (auto& source : stats.sources)
+    {
+        const auto it =
+            std::find_if(previous.sources.begin(), previous.sources.end(),
+                         [&source](const deflect::server::SourceStatistics& s) {
+                             return s.sourceIndex == source.sourceIndex;
+                         });
+        if (it != previous.sources.end())
+            _computeRates(source, *it, seconds);
+        else
+            _computeRates(source, deflect::server::SourceStatistics(), seconds);
+    }
+}
+}
 
 namespace deflect
 {
@@ -54,25 +175,47 @@ public:
     Impl() {}
     FramePtr consumeLatestFrame(const QString& uri)
     {
-        auto frame = std::make_shared<Frame>();
+        const TraceScope traceScope{"server", "dispatchFrame"};
+        auto frame = recycler->makeFrame();
         frame->uri = uri;
 
-        auto& buffer = streams[uri].buffer;
+        auto& stream = streams[uri];
+        auto& buffer = stream.buffer;
 
-        while (buffer.hasCompleteFrame())
-            frame->tiles = buffer.popFrame();
+        buffer.releaseOlderFrames();
+        frame->trace = buffer.getFrameTrace();
+        buffer.popFrame(frame->tiles);
+        frame->trace.dispatchTime = currentTimestamp();
+        recordLatencies(stream, frame->trace);
 
         assert(!frame->tiles.empty());
 
         if (frame->determineRowOrder() == RowOrder::bottom_up)
             mirrorTilesPositionsVertically(*frame);
 
+        if (recorder)
+            recorder->record(*frame);
+
         // receiver will request a new frame once this frame was consumed
         buffer.setAllowedToSend(false);
 
         return frame;
     }
 
+    struct Stream;
+    void recordLatencies(Stream& stream, const FrameTrace& trace) const
+    {
+        if (trace.receiveTime == 0)
+            return;
+
+        stream.dispatchLatency.add(trace.dispatchTime - trace.receiveTime);
+        if (trace.sendTime != 0)
+        {
+            stream.receiveLatency.add(trace.receiveTime - trace.sendTime);
+            stream.totalLatency.add(trace.dispatchTime - trace.sendTime);
+        }
+    }
+
     void mirrorTilesPositionsVertically(Frame& frame) const
     {
         const auto sizes = frame.computeChannelDimensions();
@@ -80,6 +223,47 @@ public:
             tile.y = sizes.at(tile.channel).height() - tile.y - tile.height;
     }
 
+    template <typename Func>
+    void processFrameFinished(FrameDispatcher& dispatcher, const QString& uri,
+                              const Func& finishFrame)
+    {
+        if (!streams.count(uri))
+            return;
+
+        auto& buffer = streams[uri].buffer;
+        try
+        {
+            finishFrame(buffer);
+            if (buffer.isAllowedToSend() && buffer.hasCompleteFrame())
+                emit dispatcher.sendFrame(consumeLatestFrame(uri));
+            checkMemoryBudget();
+        }
+        catch (const std::runtime_error& e)
+        {
+            emit dispatcher.pixelStreamError(uri, e.what());
+        }
+    }
+
+    size_t getByteCount() const
+    {
+        size_t byteCount = 0;
+        for (const auto& kv : streams)
+            byteCount += kv.second.buffer.getByteCount();
+        return byteCount;
+    }
+
+    void checkMemoryBudget()
+    {
+        if (memoryBudget == 0 || getByteCount() <= memoryBudget)
+            return;
+
+        for (auto& kv : streams)
+            kv.second.buffer.releaseOlderFrames();
+
+        if (getByteCount() > memoryBudget)
+            throw std::runtime_error("server memory budget exceeded");
+    }
+
     bool allConnectionsClosed(const QString& uri) const
     {
         const auto& stream = streams.at(uri);
@@ -90,8 +274,17 @@ public:
     {
         ReceiveBuffer buffer;
         size_t observers = 0;
+        StreamStatistics lastSample;
+        Clock::time_point lastSampleTime = Clock::now();
+        LatencyHistogram receiveLatency;
+        LatencyHistogram dispatchLatency;
+        LatencyHistogram totalLatency;
     };
     std::map<QString, Stream> streams;
+    size_t memoryBudget = 0;
+    std::unique_ptr<FrameRecorder> recorder;
+    std::shared_ptr<FrameRecycler> recycler{
+        std::make_shared<FrameRecycler>(nullptr)};
 };
 
 FrameDispatcher::FrameDispatcher(QObject* parent_)
@@ -104,13 +297,67 @@ FrameDispatcher::~FrameDispatcher()
 {
 }
 
-void FrameDispatcher::addSource(const QString uri, const size_t sourceIndex)
+void FrameDispatcher::setMemoryBudget(const size_t bytes)
+{
+    _impl->memoryBudget = bytes;
+}
+
+size_t FrameDispatcher::getMemoryBudget() const
+{
+    return _impl->memoryBudget;
+}
+
+void FrameDispatcher::setBufferPool(std::shared_ptr<BufferPool> pool)
+{
+    // frames already dispatched keep the previous recycler alive
+    _impl->recycler = std::make_shared<FrameRecycler>(std::move(pool));
+}
+
+void FrameDispatcher::startRecording(const QString& filename)
+{
+    _impl->recorder.reset(); // close the previous archive first
+    _impl->recorder.reset(new FrameRecorder(filename));
+}
+
+void FrameDispatcher::stopRecording()
+{
+    _impl->recorder.reset();
+}
+
+Statistics FrameDispatcher::sampleStatistics()
+{
+    const auto now = Clock::now();
+
+    Statistics statistics;
+    statistics.reserve(_impl->streams.size());
+    for (auto& kv : _impl->streams)
+    {
+        auto& stream = kv.second;
+        const std::chrono::duration<double> elapsed =
+            now - stream.lastSampleTime;
+
+        auto stats = stream.buffer.getStatistics();
+        stats.uri = kv.first;
+        stats.receiveLatency = stream.receiveLatency;
+        stats.dispatchLatency = stream.dispatchLatency;
+        stats.totalLatency = stream.totalLatency;
+        _computeRates(stats, stream.lastSample, elapsed.count());
+
+        stream.lastSample = stats;
+        stream.lastSampleTime = now;
+        statistics.push_back(std::move(stats));
+    }
+    return statistics;
+}
+
+void FrameDispatcher::addSource(const QString uri, const size_t sourceIndex,
+                                TileQueuePtr queue)
 {
     try
     {
         auto& stream = _impl->streams[uri];
 
-        stream.buffer.addSource(sourceIndex);
+        stream.buffer.addSource(sourceIndex, std::move(queue));
 
         if (stream.observers == 0 && stream.buffer.getSourceCount() == 1)
             emit pixelStreamOpened(uri);
@@ -165,20 +412,22 @@ void FrameDispatcher::processTile(const QString uri, const size_t sourceIndex,
 void FrameDispatcher::processFrameFinished(const QString uri,
                                            const size_t sourceIndex)
 {
-    if (!_impl->streams.count(uri))
-        return;
+    _impl->processFrameFinished(*this, uri,
+                                [sourceIndex](ReceiveBuffer& buffer) {
+                                    FrameTrace trace;
+                                    trace.receiveTime = currentTimestamp();
+                                    buffer.finishFrameForSource(sourceIndex,
+                                                                trace);
+                                });
+}
 
-    auto& buffer = _impl->streams[uri].buffer;
-    try
-    {
-        buffer.finishFrameForSource(sourceIndex);
-        if (buffer.isAllowedToSend() && buffer.hasCompleteFrame())
-            emit sendFrame(_impl->consumeLatestFrame(uri));
-    }
-    catch (const std::runtime_error& e)
-    {
-        emit pixelStreamError(uri, e.what());
-    }
+void FrameDispatcher::processTileQueue(const QString uri,
+                                       const size_t sourceIndex)
+{
+    _impl->processFrameFinished(*this, uri,
+                                [sourceIndex](ReceiveBuffer& buffer) {
+                                    buffer.processTileQueue(sourceIndex);
+                                });
 }
 
 void FrameDispatcher::requestFrame(const QString uri)
@@ -199,6 +448,27 @@ void FrameDispatcher::requestFrame(const QString uri)
     }
 }
 
+void FrameDispatcher::setBufferPolicy(const QString uri,
+                                      const BufferPolicy policy)
+{
+    if (_impl->streams.count(uri))
+        _impl->streams[uri].buffer.setBufferPolicy(policy);
+}
+
+void FrameDispatcher::setStreamMemoryBudget(const QString uri,
+                                            const size_t bytes)
+{
+    if (_impl->streams.count(uri))
+        _impl->streams[uri].buffer.setMemoryBudget(bytes);
+}
+
+size_t FrameDispatcher::getDroppedFrameCount(const QString& uri) const
+{
+    if (!_impl->streams.count(uri))
+        return 0;
+    return _impl->streams.at(uri).buffer.getDroppedFrameCount();
+}
+
 void FrameDispatcher::deleteStream(const QString uri)
 {
     _impl->streams.erase(uri);
@@ -41,10 +41,12 @@
 #define DEFLECT_SERVER_FRAMEDISPATCHER_H
 
 #include <deflect/api.h>
+#include <deflect/server/Statistics.h>
 #include <deflect/server/Tile.h>
 
 #include <QObject>
 #include <map>
+#include <memory>
 
 namespace deflect
 {
@@ -64,14 +66,69 @@ public:
     /** Destructor. */
     ~FrameDispatcher();
 
+    /**
+     * @param uri Identifier for the stream
+     * @return the number of complete frames of the stream which were dropped
+     *         without being dispatched.
+     */
+    size_t getDroppedFrameCount(const QString& uri) const;
+
+    /**
+     * Set the maximum number of bytes of image data buffered for all streams.
+     *
+     * When the budget is exceeded, the older complete frames of all streams
+     * are released. If it is still exceeded, the stream which received the
+     * last frame is closed with a pixelStreamError().
+     *
+     * @param bytes The memory budget, 0 for unlimited (default)
+     */
+    void setMemoryBudget(size_t bytes);
+
+    /** @return the memory budget for all streams, 0 if unlimited. */
+    size_t getMemoryBudget() const;
+
+    /**
+     * Recycle the dispatched frames once all their copies are destroyed.
+     *
+     * The image data of their tiles is released to the given pool, from which
+     * the ServerWorkers receive the following tiles.
+     *
+     * @param pool The pool of buffers, nullptr to simply free the image data
+     *        (default)
+     */
+    void setBufferPool(std::shared_ptr<BufferPool> pool);
+
+    /**
+     * Record all dispatched frames to an archive.
+     *
+     * @param filename The archive data file
+     * @throw std::runtime_error if the archive could not be created
+     * @see FrameRecorder
+     */
+    void startRecording(const QString& filename);
+
+    /** Stop recording, writing all pending frames to the archive. */
+    void stopRecording();
+
+    /**
+     * Sample the statistics of all streams.
+     *
+     * @return the statistics of each stream, with the rates averaged since the
+     *         previous sample or since the stream was opened.
+     */
+    Statistics sampleStatistics();
+
 public slots:
     /**
      * Add a source of Tiles for a Stream.
      *
      * @param uri Identifier for the stream
      * @param sourceIndex Identifier for the source in this stream
+     * @param queue Optional queue through which the source pushes its Tiles,
+     *        see processTileQueue().
      */
-    void addSource(QString uri, size_t sourceIndex);
+    void addSource(QString uri, size_t sourceIndex,
+                   deflect::server::TileQueuePtr queue = nullptr);
 
     /**
      * Remove a source of Tiles for a Stream.
@@ -115,6 +172,18 @@ public slots:
      */
     void processFrameFinished(QString uri, size_t sourceIndex);
 
+    /**
+     * The given source has pushed one or more frames to its TileQueue.
+     *
+     * This is the preferred alternative to processTile() and
+     * processFrameFinished() for sources running in a different thread, as it
+     * requires only one cross-thread notification per frame.
+     *
+     * @param uri Identifier for the stream
+     * @param sourceIndex Identifier for the source in the stream
+     */
+    void processTileQueue(QString uri, size_t sourceIndex);
+
     /**
      * Request the dispatching of a new frame for any stream (mono/stereo).
      *
@@ -128,6 +197,23 @@ public slots:
      */
     void requestFrame(QString uri);
 
+    /**
+     * Set the buffering policy for the frames of a Stream.
+     *
+     * @param uri Identifier for the stream
+     * @param policy The policy to apply
+     */
+    void setBufferPolicy(QString uri, deflect::server::BufferPolicy policy);
+
+    /**
+     * Set the maximum number of bytes of image data buffered for a Stream.
+     *
+     * @param uri Identifier for the stream
+     * @param bytes The memory budget, 0 for unlimited (default)
+     * @see ReceiveBuffer::setMemoryBudget()
+     */
+    void setStreamMemoryBudget(QString uri, size_t bytes);
+
     /**
      * Delete all the buffers for a Stream.
      *
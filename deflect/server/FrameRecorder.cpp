@@ -0,0 +1,253 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "FrameRecorder.h"
+
+#include "ArchiveFormat.h"
+#include "Frame.h"
+#include "deflect/MTQueue.h"
+
+#include <QFile>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace deflect
+{
+namespace server
+{
+namespace
+{
+const int flushThreshold = 8 * 1024 * 1024;
+
+template <typename T>
+void _append(QByteArray& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void _open(QFile& file, const QString& filename)
+{
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw std::runtime_error("could not open archive file: " +
+                                 filename.toStdString());
+    }
+}
+}
+
+class FrameRecorder::Impl
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct Record
+    {
+        Frame frame;
+        uint64_t timestamp;
+        size_t size; // of the image data
+    };
+    using RecordPtr = std::shared_ptr<Record>;
+
+    Impl(const QString& filename, const size_t maxQueuedBytes_)
+        : maxQueuedBytes(maxQueuedBytes_)
+    {
+        _open(dataFile, filename);
+        _open(indexFile, filename + archive::indexSuffix);
+
+        archive::FileHeader header;
+        std::memcpy(header.magic, archive::magic, sizeof(header.magic));
+        header.version = archive::version;
+        header.reserved = 0;
+        _append(data, header);
+
+        writeThread = std::thread([this] { write(); });
+    }
+
+    ~Impl()
+    {
+        queue.enqueue(nullptr);
+        writeThread.join();
+    }
+
+    void write()
+    {
+        data.reserve(flushThreshold + flushThreshold / 2);
+        while (auto record = queue.dequeue())
+        {
+            if (failed)
+            {
+                queuedBytes -= record->size;
+                continue;
+            }
+
+            _append(index, uint64_t(dataOffset + data.size()));
+            serialize(*record);
+            queuedBytes -= record->size;
+
+            if (data.size() >= flushThreshold || queue.empty())
+                flush();
+        }
+        flush();
+    }
+
+    void serialize(const Record& record)
+    {
+        const auto uri = record.frame.uri.toUtf8();
+
+        archive::FrameHeader frameHeader;
+        frameHeader.timestamp = record.timestamp;
+        frameHeader.tileCount = record.frame.tiles.size();
+        frameHeader.uriSize = uri.size();
+        _append(data, frameHeader);
+        data.append(uri);
+
+        for (const auto& tile : record.frame.tiles)
+        {
+            archive::TileHeader tileHeader;
+            tileHeader.x = tile.x;
+            tileHeader.y = tile.y;
+            tileHeader.width = tile.width;
+            tileHeader.height = tile.height;
+            tileHeader.dataSize = tile.imageData.size();
+            tileHeader.format = uint8_t(tile.format);
+            tileHeader.rowOrder = uint8_t(tile.rowOrder);
+            tileHeader.view = uint8_t(tile.view);
+            tileHeader.channel = tile.channel;
+            _append(data, tileHeader);
+            data.append(tile.imageData);
+        }
+        ++pendingFrames;
+    }
+
+    void flush()
+    {
+        if (failed || data.isEmpty())
+            return;
+
+        // Write the frames before their index so that the index never refers
+        // to incomplete frames.
+        if (dataFile.write(data) != data.size() || !dataFile.flush() ||
+            indexFile.write(index) != index.size() || !indexFile.flush())
+        {
+            failed = true;
+            return;
+        }
+        dataOffset += data.size();
+        recordedFrames += pendingFrames;
+        pendingFrames = 0;
+        data.resize(0);
+        index.resize(0);
+    }
+
+    QFile dataFile;
+    QFile indexFile;
+    QByteArray data;
+    QByteArray index;
+    uint64_t dataOffset = 0;
+    size_t pendingFrames = 0;
+
+    const clock::time_point startTime = clock::now();
+    MTQueue<RecordPtr> queue;
+    const size_t maxQueuedBytes;
+    std::atomic<size_t> queuedBytes{0};
+    std::atomic<size_t> droppedFrames{0};
+    std::atomic<size_t> recordedFrames{0};
+    std::atomic<bool> failed{false};
+    std::thread writeThread;
+};
+
+FrameRecorder::FrameRecorder(const QString& filename,
+                             const size_t maxQueuedBytes)
+    : _impl(new Impl(filename, maxQueuedBytes))
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+}
+
+void FrameRecorder::record(const Frame& frame)
+{
+    using namespace std::chrono;
+    const auto elapsed = Impl::clock::now() - _impl->startTime;
+    const auto timestamp = duration_cast<microseconds>(elapsed).count();
+
+    size_t size = 0;
+    for (const auto& tile : frame.tiles)
+        size += tile.imageData.size();
+
+    // record() is not called concurrently, so the queued bytes can only
+    // decrease between the check and the addition.
+    const auto queuedBytes = _impl->queuedBytes.load();
+    if (queuedBytes > 0 && queuedBytes + size > _impl->maxQueuedBytes)
+    {
+        ++_impl->droppedFrames;
+        return;
+    }
+    _impl->queuedBytes += size;
+
+    // Shallow copy of the tiles' image data
+    auto record = std::make_shared<Impl::Record>();
+    record->frame = frame;
+    record->timestamp = timestamp;
+    record->size = size;
+    _impl->queue.enqueue(record);
+}
+
+size_t FrameRecorder::getRecordedFrameCount() const
+{
+    return _impl->recordedFrames;
+}
+
+size_t FrameRecorder::getDroppedFrameCount() const
+{
+    return _impl->droppedFrames;
+}
+
+bool FrameRecorder::hasFailed() const
+{
+    return _impl->failed;
+}
+}
+}
@@ -0,0 +1,118 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_FRAMERECORDER_H
+#define DEFLECT_SERVER_FRAMERECORDER_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QString>
+
+#include <memory>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Record frames to an archive which can be read back with FrameArchive.
+ *
+ * Recording a frame only takes a shallow copy of its tiles; the frame is
+ * serialized and written to disk in large sequential blocks by a background
+ * thread. The frame can thus be modified (e.g. decoded) right after it has
+ * been recorded.
+ *
+ * The tiles are recorded in the format in which they are given; frames which
+ * have been decoded by the Server (see Server::setTileDecoding()) are thus
+ * recorded uncompressed.
+ *
+ * The frames waiting to be written are bounded in size; when the disk can not
+ * keep up, new frames are dropped and counted by getDroppedFrameCount().
+ */
+class FrameRecorder
+{
+public:
+    /** Default maximum size of the frames waiting to be written. */
+    static const size_t defaultMaxQueuedBytes = 256 * 1024 * 1024;
+
+    /**
+     * Create a new archive and start the writing thread.
+     *
+     * @param filename The archive data file, the index file is created next to
+     *        it. Existing files are overwritten.
+     * @param maxQueuedBytes The maximum size of the image data of the frames
+     *        waiting to be written. A frame is always accepted if no other
+     *        frame is waiting, whatever its size.
+     * @throw std::runtime_error if the files could not be created.
+     */
+    DEFLECT_API explicit FrameRecorder(
+        const QString& filename, size_t maxQueuedBytes = defaultMaxQueuedBytes);
+
+    /** Write all pending frames and close the archive. */
+    DEFLECT_API ~FrameRecorder();
+
+    /**
+     * Record a frame.
+     *
+     * @param frame The frame to append to the archive. It is dropped if the
+     *        frames waiting to be written already reach the maximum size.
+     */
+    DEFLECT_API void record(const Frame& frame);
+
+    /** @return the number of frames written to the archive so far. */
+    DEFLECT_API size_t getRecordedFrameCount() const;
+
+    /** @return the number of frames dropped because the queue was full. */
+    DEFLECT_API size_t getDroppedFrameCount() const;
+
+    /** @return true if writing to the archive has failed. */
+    DEFLECT_API bool hasFailed() const;
+
+private:
+    FrameRecorder(const FrameRecorder&) = delete;
+    const FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+};
+}
+}
+
+#endif
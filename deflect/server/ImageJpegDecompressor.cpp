@@ -39,6 +39,8 @@
 
 #include "ImageJpegDecompressor.h"
 
+#include "BufferPool.h"
+
 #include <iostream>
 #include <stdexcept>
 
@@ -98,23 +100,73 @@ JpegHeader ImageJpegDecompressor::decompressHeader(const QByteArray& jpegData)
     return header;
 }
 
+void ImageJpegDecompressor::setScale(const unsigned int denominator)
+{
+    if (denominator != 1 && denominator != 2 && denominator != 4 &&
+        denominator != 8)
+    {
+        throw std::invalid_argument("unsupported decompression scale");
+    }
+    _scale = int(denominator);
+}
+
+unsigned int ImageJpegDecompressor::getScale() const
+{
+    return _scale;
+}
+
+void ImageJpegDecompressor::setBufferPool(std::shared_ptr<BufferPool> pool)
+{
+    _bufferPool = std::move(pool);
+}
+
+QByteArray ImageJpegDecompressor::_allocate(const int size)
+{
+    if (_bufferPool)
+        return _bufferPool->acquire(size);
+    return QByteArray(size, Qt::Uninitialized);
+}
+
+JpegHeader ImageJpegDecompressor::_decompressScaledHeader(
+    const QByteArray& jpegData)
+{
+    auto header = decompressHeader(jpegData);
+    const tjscalingfactor scalingFactor{1, _scale};
+    header.width = TJSCALED(header.width, scalingFactor);
+    header.height = TJSCALED(header.height, scalingFactor);
+    return header;
+}
+
 QByteArray ImageJpegDecompressor::decompress(const QByteArray& jpegData)
 {
-    const auto header = decompressHeader(jpegData);
+    const auto header = _decompressScaledHeader(jpegData);
+    const int pitch = header.width * tjPixelSize[TJPF_RGBX];
+
+    auto decodedData = _allocate(header.height * pitch);
+    _decompress(jpegData, header, (unsigned char*)decodedData.data(), pitch);
+
+    return decodedData;
+}
+
+void ImageJpegDecompressor::decompress(const QByteArray& jpegData,
+                                       uint8_t* buffer, const int pitch)
+{
+    _decompress(jpegData, _decompressScaledHeader(jpegData), buffer, pitch);
+}
+
+void ImageJpegDecompressor::_decompress(const QByteArray& jpegData,
+                                        const JpegHeader& header,
+                                        unsigned char* buffer, const int pitch)
+{
     const int pixelFormat = TJPF_RGBX; // Format for OpenGL texture (GL_RGBA)
-    const int pitch = header.width * tjPixelSize[pixelFormat];
     const int flags = TJ_FASTUPSAMPLE;
 
-    QByteArray decodedData(header.height * pitch, Qt::Uninitialized);
-
     int err = tjDecompress2(_tjHandle, (unsigned char*)jpegData.data(),
-                            (unsigned long)jpegData.size(),
-                            (unsigned char*)decodedData.data(), header.width,
-                            pitch, header.height, pixelFormat, flags);
+                            (unsigned long)jpegData.size(), buffer,
+                            header.width, pitch, header.height, pixelFormat,
+                            flags);
     if (err != 0)
         throw std::runtime_error("libjpeg-turbo image decompression failed");
-
-    return decodedData;
 }
 
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
@@ -122,14 +174,14 @@ QByteArray ImageJpegDecompressor::decompress(const QByteArray& jpegData)
 ImageJpegDecompressor::YUVData ImageJpegDecompressor::decompressToYUV(
     const QByteArray& jpegData)
 {
-    const auto header = decompressHeader(jpegData);
+    const auto header = _decompressScaledHeader(jpegData);
     const int pad = 1; // no padding
     const int flags = 0;
     const int jpegSubsamp = int(header.subsampling);
     const auto decodedSize =
         tjBufSizeYUV2(header.width, pad, header.height, jpegSubsamp);
 
-    auto decodedData = QByteArray(decodedSize, Qt::Uninitialized);
+    auto decodedData = _allocate(int(decodedSize));
 
     int err = tjDecompressToYUV2(_tjHandle, (unsigned char*)jpegData.data(),
                                  (unsigned long)jpegData.size(),
@@ -48,6 +48,8 @@
 
 #include <QByteArray>
 
+#include <memory>
+
 namespace deflect
 {
 namespace server
@@ -80,15 +82,55 @@ public:
      */
     DEFLECT_API JpegHeader decompressHeader(const QByteArray& jpegData);
 
+    /**
+     * Set the scale at which images are decompressed.
+     *
+     * libjpeg-turbo scales the images in the DCT domain, which is much faster
+     * than decompressing them at full size. The decompressed images have a
+     * size of ceil(width / denominator) x ceil(height / denominator).
+     *
+     * @param denominator 1 (full size, default), 2, 4 or 8
+     * @throw std::invalid_argument if the scale is not supported
+     */
+    DEFLECT_API void setScale(unsigned int denominator);
+
+    /** @return the denominator of the decompression scale. */
+    DEFLECT_API unsigned int getScale() const;
+
+    /**
+     * Acquire the buffers returned by decompress() and decompressToYUV() from
+     * a pool instead of allocating a new one for each image.
+     *
+     * @param pool The pool of buffers, nullptr to allocate them (default)
+     */
+    DEFLECT_API void setBufferPool(std::shared_ptr<BufferPool> pool);
+
     /**
      * Decompress a Jpeg image.
      *
+     * The buffer is acquired from the pool if one was set, see
+     * setBufferPool(). To decode into persistent memory instead, decompress
+     * into a caller-provided buffer.
+     *
      * @param jpegData The compressed Jpeg data
      * @return The decompressed image data in (GL_)RGBA format
      * @throw std::runtime_error if a decompression error occured
      */
     DEFLECT_API QByteArray decompress(const QByteArray& jpegData);
 
+    /**
+     * Decompress a Jpeg image into a caller-provided buffer.
+     *
+     * @param jpegData The compressed Jpeg data
+     * @param buffer The destination of the image data in (GL_)RGBA format,
+     *        which must hold at least (scaled) height * pitch bytes
+     * @param pitch The number of bytes per row of the buffer, or 0 for
+     *        (scaled) width * 4
+     * @throw std::runtime_error if a decompression error occured
+     */
+    DEFLECT_API void decompress(const QByteArray& jpegData, uint8_t* buffer,
+                                int pitch = 0);
+
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
     using YUVData = std::pair<QByteArray, ChromaSubsampling>;
@@ -107,6 +149,19 @@ public:
 private:
     /** libjpeg-turbo handle for decompression */
     tjhandle _tjHandle;
+
+    /** Denominator of the decompression scale */
+    int _scale = 1;
+
+    /** Optional pool of the buffers of the decompressed images */
+    std::shared_ptr<BufferPool> _bufferPool;
+
+    QByteArray _allocate(int size);
+
+    JpegHeader _decompressScaledHeader(const QByteArray& jpegData);
+
+    void _decompress(const QByteArray& jpegData, const JpegHeader& header,
+                     unsigned char* buffer, int pitch);
 };
 }
 }
@@ -39,28 +39,48 @@
 
 #include "ReceiveBuffer.h"
 
+#include "TileQueue.h"
+
+#include "deflect/Tracer.h"
+
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace
 {
 const size_t MAX_QUEUE_SIZE = 150; // stream blocked for ~5 seconds at 30Hz
+
+/** @return the lowest of two values, ignoring the unknown (0) ones. */
+template <typename T>
+T _lowestKnown(const T a, const T b)
+{
+    if (a == 0)
+        return b;
+    if (b == 0)
+        return a;
+    return std::min(a, b);
+}
 }
 
 namespace deflect
 {
 namespace server
 {
-void ReceiveBuffer::addSource(const size_t sourceIndex)
+void ReceiveBuffer::addSource(const size_t sourceIndex, TileQueuePtr queue)
 {
     if (_lastFrameComplete > 0)
         throw std::runtime_error("Stream already started; late join forbidden");
 
     _sourceBuffers.emplace(sourceIndex, SourceBuffer());
+    if (queue)
+        _tileQueues.emplace(sourceIndex, std::move(queue));
 }
 
 void ReceiveBuffer::removeSource(const size_t sourceIndex)
 {
     _sourceBuffers.erase(sourceIndex);
+    _tileQueues.erase(sourceIndex);
 
     // reset for new sources starting with getBackFrameIndex() == 0
     if (_sourceBuffers.empty())
@@ -79,44 +99,149 @@ void ReceiveBuffer::insert(const Tile& tile, const size_t sourceIndex)
     _sourceBuffers[sourceIndex].insert(tile);
 }
 
-void ReceiveBuffer::finishFrameForSource(const size_t sourceIndex)
+void ReceiveBuffer::finishFrameForSource(const size_t sourceIndex,
+                                         const FrameTrace& trace)
 {
+    const TraceScope traceScope{"server", "finishFrame"};
     assert(_sourceBuffers.count(sourceIndex));
 
     auto& buffer = _sourceBuffers[sourceIndex];
     if (buffer.getQueueSize() > MAX_QUEUE_SIZE)
         throw std::runtime_error("maximum queue size exceeded");
 
-    buffer.push();
+    buffer.push(trace);
+
+    if (_policy == BufferPolicy::latest_frame)
+        releaseOlderFrames();
+
+    if (_memoryBudget > 0 && getByteCount() > _memoryBudget)
+    {
+        releaseOlderFrames();
+        if (getByteCount() > _memoryBudget)
+            throw std::runtime_error("stream memory budget exceeded");
+    }
+}
+
+void ReceiveBuffer::processTileQueue(const size_t sourceIndex)
+{
+    const auto it = _tileQueues.find(sourceIndex);
+    if (it == _tileQueues.end())
+        return;
+
+    assert(_sourceBuffers.count(sourceIndex));
+
+    auto& queue = *it->second;
+    auto& buffer = _sourceBuffers[sourceIndex];
+
+    Tile tile;
+    bool frameFinished = false;
+    FrameTrace trace;
+    while (queue.pop(tile, frameFinished, trace))
+    {
+        if (frameFinished)
+            finishFrameForSource(sourceIndex, trace);
+        else
+            buffer.insert(std::move(tile));
+    }
 }
 
 bool ReceiveBuffer::hasCompleteFrame() const
 {
-    // Check if all sources for Stream have reached the same index
+    return _getCompleteFrameCount() > 0;
+}
+
+FrameTrace ReceiveBuffer::getFrameTrace() const
+{
+    FrameTrace trace;
     for (const auto& kv : _sourceBuffers)
     {
         const auto& buffer = kv.second;
         if (buffer.getBackFrameIndex() <= _lastFrameComplete)
-            return false;
+            continue;
+
+        const auto& source = buffer.getFrameTrace();
+        trace.frameNumber =
+            _lowestKnown(trace.frameNumber, source.frameNumber);
+        trace.sendTime = _lowestKnown(trace.sendTime, source.sendTime);
+        trace.receiveTime = std::max(trace.receiveTime, source.receiveTime);
     }
-    return !_sourceBuffers.empty();
+    return trace;
 }
 
 Tiles ReceiveBuffer::popFrame()
 {
     Tiles frame;
+    popFrame(frame);
+    return frame;
+}
+
+void ReceiveBuffer::popFrame(Tiles& frame)
+{
+    size_t tileCount = 0;
+    for (const auto& kv : _sourceBuffers)
+    {
+        const auto& buffer = kv.second;
+        if (buffer.getBackFrameIndex() > _lastFrameComplete)
+            tileCount += buffer.getTiles().size();
+    }
+
+    frame.clear();
     for (auto& kv : _sourceBuffers)
     {
         auto& buffer = kv.second;
-        if (buffer.getBackFrameIndex() > _lastFrameComplete)
-        {
-            const auto& tiles = buffer.getTiles();
-            frame.insert(frame.end(), tiles.begin(), tiles.end());
-            buffer.pop();
-        }
+        if (buffer.getBackFrameIndex() <= _lastFrameComplete)
+            continue;
+        if (!frame.empty())
+            frame.reserve(tileCount);
+        buffer.pop(frame);
     }
     ++_lastFrameComplete;
-    return frame;
+    ++_poppedFrameCount;
+}
+
+Tiles ReceiveBuffer::popLatestFrame()
+{
+    releaseOlderFrames();
+    return popFrame();
+}
+
+void ReceiveBuffer::releaseOlderFrames()
+{
+    while (_getCompleteFrameCount() > 1)
+        _dropFrame();
+}
+
+size_t ReceiveBuffer::getByteCount() const
+{
+    size_t byteCount = 0;
+    for (const auto& kv : _sourceBuffers)
+        byteCount += kv.second.getByteCount();
+    return byteCount;
+}
+
+void ReceiveBuffer::setMemoryBudget(const size_t bytes)
+{
+    _memoryBudget = bytes;
+}
+
+size_t ReceiveBuffer::getMemoryBudget() const
+{
+    return _memoryBudget;
+}
+
+void ReceiveBuffer::setBufferPolicy(const BufferPolicy policy)
+{
+    _policy = policy;
+}
+
+BufferPolicy ReceiveBuffer::getBufferPolicy() const
+{
+    return _policy;
+}
+
+size_t ReceiveBuffer::getDroppedFrameCount() const
+{
+    return _droppedFrameCount;
 }
 
 void ReceiveBuffer::setAllowedToSend(const bool enable)
@@ -124,9 +249,83 @@ void ReceiveBuffer::setAllowedToSend(const bool enable)
     _allowedToSend = enable;
 }
 
+size_t ReceiveBuffer::getPoppedFrameCount() const
+{
+    return _poppedFrameCount;
+}
+
+StreamStatistics ReceiveBuffer::getStatistics() const
+{
+    StreamStatistics stats;
+    stats.sources.reserve(_sourceBuffers.size());
+    for (const auto& kv : _sourceBuffers)
+    {
+        const auto& buffer = kv.second;
+
+        SourceStatistics source;
+        source.sourceIndex = kv.first;
+        // the back frame is the one being received
+        source.queuedFrames = buffer.getQueueSize() - 1;
+        source.bufferedBytes = buffer.getByteCount();
+
+        const auto it = _tileQueues.find(kv.first);
+        if (it != _tileQueues.end())
+        {
+            const auto& queue = *it->second;
+            source.receivedBytes = queue.getReceivedByteCount();
+            source.receivedTiles = queue.getPushedTileCount();
+            source.receivedFrames = queue.getFinishedFrameCount();
+            source.clockSynchronized = queue.isClockSynchronized();
+            source.clockOffset = queue.getClockOffset();
+            source.roundTripTime = queue.getRoundTripTime();
+        }
+
+        stats.receivedBytes += source.receivedBytes;
+        stats.receivedTiles += source.receivedTiles;
+        stats.bufferedBytes += source.bufferedBytes;
+        stats.sources.push_back(source);
+    }
+    stats.queuedFrames = _getCompleteFrameCount();
+    stats.dispatchedFrames = _poppedFrameCount;
+    stats.droppedFrames = _droppedFrameCount;
+    stats.completeFrames =
+        stats.dispatchedFrames + stats.droppedFrames + stats.queuedFrames;
+    return stats;
+}
+
 bool ReceiveBuffer::isAllowedToSend() const
 {
     return _allowedToSend;
 }
+
+FrameIndex ReceiveBuffer::_getCompleteFrameCount() const
+{
+    if (_sourceBuffers.empty())
+        return 0;
+
+    // Count the frames for which all sources of the Stream have finished
+    auto completeFrameIndex = std::numeric_limits<FrameIndex>::max();
+    for (const auto& kv : _sourceBuffers)
+    {
+        const auto& buffer = kv.second;
+        completeFrameIndex =
+            std::min(completeFrameIndex, buffer.getBackFrameIndex());
+    }
+    if (completeFrameIndex <= _lastFrameComplete)
+        return 0;
+    return completeFrameIndex - _lastFrameComplete;
+}
+
+void ReceiveBuffer::_dropFrame()
+{
+    for (auto& kv : _sourceBuffers)
+    {
+        auto& buffer = kv.second;
+        if (buffer.getBackFrameIndex() > _lastFrameComplete)
+            buffer.pop();
+    }
+    ++_lastFrameComplete;
+    ++_droppedFrameCount;
+}
 }
 }
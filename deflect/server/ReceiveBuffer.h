@@ -42,6 +42,7 @@
 
 #include <deflect/api.h>
 #include <deflect/server/SourceBuffer.h>
+#include <deflect/server/Statistics.h>
 
 #include <map>
 #include <queue>
@@ -62,10 +63,13 @@ public:
     /**
      * Add a source of tiles.
      * @param sourceIndex Unique source identifier
+     * @param queue Optional queue through which the source pushes its tiles
+     *        from another thread, see processTileQueue().
      * @throw std::runtime_error if finishFrameForSource() has already been
      *        called for all existing sources (reject late joiners).
      */
-    DEFLECT_API void addSource(size_t sourceIndex);
+    DEFLECT_API void addSource(size_t sourceIndex,
+                               TileQueuePtr queue = nullptr);
 
     /**
      * Remove a source of tiles.
@@ -86,19 +90,101 @@ public:
     /**
      * Call when the source has finished sending tiles for the current frame.
      * @param sourceIndex Unique source identifier
+     * @param trace The trace of the frame for this source
+     * @throw std::runtime_error if the buffer exceeds its maximum size or its
+     *        memory budget, even after releasing the older complete frames
+     */
+    DEFLECT_API void finishFrameForSource(
+        size_t sourceIndex, const FrameTrace& trace = FrameTrace());
+
+    /**
+     * Insert the tiles and finished frames pushed to the source's TileQueue.
+     *
+     * Does nothing if the source was not added with a queue.
+     * @param sourceIndex Unique source identifier
      * @throw std::runtime_error if the buffer exceeds its maximum size
      */
-    DEFLECT_API void finishFrameForSource(size_t sourceIndex);
+    DEFLECT_API void processTileQueue(size_t sourceIndex);
 
     /** Does the Buffer have a new complete frame (from all sources) */
     DEFLECT_API bool hasCompleteFrame() const;
 
+    /**
+     * Get the trace of the frame which will be returned by popFrame().
+     *
+     * The frame number and send time are the lowest ones among the sources,
+     * and the receive time the latest one.
+     */
+    DEFLECT_API FrameTrace getFrameTrace() const;
+
     /**
      * Get the finished frame.
      * @return A collection of tiles that form a frame
      */
     DEFLECT_API Tiles popFrame();
 
+    /**
+     * Get the finished frame into the given list of tiles.
+     *
+     * The list is cleared first, then exchanged with the one which holds the
+     * tiles in the buffer, so that passing a list reused across frames avoids
+     * allocating a new one for each frame.
+     * @param frame The list which receives the tiles that form the frame
+     */
+    DEFLECT_API void popFrame(Tiles& frame);
+
+    /**
+     * Get the most recent finished frame, dropping all the older ones.
+     * @return A collection of tiles that form a frame
+     */
+    DEFLECT_API Tiles popLatestFrame();
+
+    /** Release all the complete frames except the most recent one. */
+    DEFLECT_API void releaseOlderFrames();
+
+    /** @return the number of bytes of image data held by the buffer. */
+    DEFLECT_API size_t getByteCount() const;
+
+    /**
+     * Set the maximum number of bytes of image data held by the buffer.
+     *
+     * When the budget is exceeded upon finishing a frame, the older complete
+     * frames are released. If it is still exceeded, finishFrameForSource()
+     * throws an exception.
+     *
+     * @param bytes The memory budget, 0 for unlimited (default)
+     */
+    DEFLECT_API void setMemoryBudget(size_t bytes);
+
+    /** @return the memory budget in bytes, 0 if unlimited. */
+    DEFLECT_API size_t getMemoryBudget() const;
+
+    /**
+     * Set the buffering policy for the complete frames.
+     *
+     * With BufferPolicy::latest_frame, the older complete frames are released
+     * as soon as a newer frame is completed by all sources, which bounds the
+     * memory usage to about two frames per source.
+     */
+    DEFLECT_API void setBufferPolicy(BufferPolicy policy);
+
+    /** @return the current buffering policy. */
+    DEFLECT_API BufferPolicy getBufferPolicy() const;
+
+    /** @return the number of complete frames that were dropped so far. */
+    DEFLECT_API size_t getDroppedFrameCount() const;
+
+    /** @return the number of frames that were popped so far. */
+    DEFLECT_API size_t getPoppedFrameCount() const;
+
+    /**
+     * Sample the counters of the buffer and of its sources.
+     *
+     * The reception counters are only available for the sources which were
+     * added with a TileQueue. The rates and the uri are left for the caller.
+     */
+    DEFLECT_API StreamStatistics getStatistics() const;
+
     /** Allow this buffer to be used by the next
      * FrameDispatcher::sendLatestFrame */
     DEFLECT_API void setAllowedToSend(bool enable);
@@ -109,7 +195,15 @@ public:
 private:
     FrameIndex _lastFrameComplete = 0;
     std::map<size_t, SourceBuffer> _sourceBuffers;
+    std::map<size_t, TileQueuePtr> _tileQueues;
     bool _allowedToSend = false;
+    BufferPolicy _policy = BufferPolicy::all_frames;
+    size_t _droppedFrameCount = 0;
+    size_t _poppedFrameCount = 0;
+    size_t _memoryBudget = 0;
+
+    FrameIndex _getCompleteFrameCount() const;
+    void _dropFrame();
 };
 }
 }
@@ -40,11 +40,15 @@
 
 #include "Server.h"
 
+#include "BufferPool.h"
 #include "FrameDispatcher.h"
 #include "ServerWorker.h"
 #include "deflect/NetworkProtocol.h"
+#include "deflect/defines.h"
 
 #include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 #include <QtNetwork/QNetworkProxy>
 #include <QtNetwork/QTcpServer>
 
@@ -56,6 +60,12 @@ namespace server
 {
 const int Server::defaultPortNumber = DEFAULT_PORT_NUMBER;
 
+namespace
+{
+// Bytes of received tiles kept for reuse, shared by all the connections
+const size_t BUFFER_POOL_BYTES = 64 * 1024 * 1024;
+}
+
 class Server::Impl : public QTcpServer
 {
 public:
@@ -64,6 +74,7 @@ public:
         , server{parent_}
         , frameDispatcher{new FrameDispatcher{parent_}}
     {
+        frameDispatcher->setBufferPool(bufferPool);
         setProxy(QNetworkProxy::NoProxy);
         if (!listen(QHostAddress::Any, port))
         {
@@ -93,6 +104,8 @@ public:
         try
         {
             auto worker = new ServerWorker(socketHandle);
+            worker->setTileDecoding(tileDecoding, &decodingThreadPool);
+            worker->setBufferPool(bufferPool);
             auto workerThread = new QThread(this);
             worker->moveToThread(workerThread);
 
@@ -118,16 +131,16 @@ public:
                     &Server::pixelStreamException);
             connect(server, &Server::_closePixelStream, worker,
                     &ServerWorker::closeConnections);
+            connect(server, &Server::_frameDispatched, worker,
+                    &ServerWorker::grantFrameCredit);
 
             // FrameDispatcher
             connect(worker, &ServerWorker::addStreamSource, frameDispatcher,
                     &FrameDispatcher::addSource);
             connect(frameDispatcher, &FrameDispatcher::sourceRejected, worker,
                     &ServerWorker::closeConnection);
-            connect(worker, &ServerWorker::receivedTile, frameDispatcher,
-                    &FrameDispatcher::processTile);
             connect(worker, &ServerWorker::receivedFrameFinished,
-                    frameDispatcher, &FrameDispatcher::processFrameFinished);
+                    frameDispatcher, &FrameDispatcher::processTileQueue);
             connect(worker, &ServerWorker::removeStreamSource, frameDispatcher,
                     &FrameDispatcher::removeSource);
             connect(worker, &ServerWorker::addObserver, frameDispatcher,
@@ -145,6 +158,11 @@ public:
 
     Server* server = nullptr;
     FrameDispatcher* frameDispatcher = nullptr; // owned by QObject's parent
+    TileDecoding tileDecoding = TileDecoding::none;
+    QThreadPool decodingThreadPool;
+    QTimer statisticsTimer;
+    std::shared_ptr<BufferPool> bufferPool{
+        std::make_shared<BufferPool>(BUFFER_POOL_BYTES)};
 };
 
 Server::Server(const int port)
@@ -157,6 +175,8 @@ Server::Server(const int port)
             &Server::pixelStreamClosed);
     connect(_impl->frameDispatcher, &FrameDispatcher::sendFrame, this,
             &Server::receivedFrame);
+    connect(_impl->frameDispatcher, &FrameDispatcher::sendFrame,
+            [this](FramePtr frame) { emit _frameDispatched(frame->uri); });
     connect(_impl->frameDispatcher, &FrameDispatcher::pixelStreamWarning, this,
             &Server::pixelStreamException);
     connect(_impl->frameDispatcher, &FrameDispatcher::pixelStreamError,
@@ -164,6 +184,9 @@ Server::Server(const int port)
                 emit pixelStreamException(uri, what);
                 closePixelStream(uri);
             });
+
+    connect(&_impl->statisticsTimer, &QTimer::timeout,
+            [this]() { emit statisticsUpdated(getStatistics()); });
 }
 
 Server::~Server()
@@ -176,11 +199,68 @@ quint16 Server::getPort() const
     return _impl->serverPort();
 }
 
+size_t Server::getDroppedFrameCount(const QString& uri) const
+{
+    return _impl->frameDispatcher->getDroppedFrameCount(uri);
+}
+
+void Server::setMemoryBudget(const size_t bytes)
+{
+    _impl->frameDispatcher->setMemoryBudget(bytes);
+}
+
+void Server::setTileDecoding(const TileDecoding mode, const int threadCount)
+{
+#ifndef DEFLECT_USE_LIBJPEGTURBO
+    if (mode != TileDecoding::none)
+        throw std::invalid_argument("tile decoding requires libjpeg-turbo");
+#elif defined(DEFLECT_USE_LEGACY_LIBJPEGTURBO)
+    if (mode == TileDecoding::yuv)
+        throw std::invalid_argument("yuv decoding requires libjpeg-turbo 1.4");
+#endif
+    _impl->tileDecoding = mode;
+    _impl->decodingThreadPool.setMaxThreadCount(
+        threadCount > 0 ? threadCount : QThread::idealThreadCount());
+}
+
+void Server::startRecording(const QString& filename)
+{
+    _impl->frameDispatcher->startRecording(filename);
+}
+
+void Server::stopRecording()
+{
+    _impl->frameDispatcher->stopRecording();
+}
+
+Statistics Server::getStatistics()
+{
+    return _impl->frameDispatcher->sampleStatistics();
+}
+
+void Server::setStatisticsInterval(const int milliseconds)
+{
+    if (milliseconds > 0)
+        _impl->statisticsTimer.start(milliseconds);
+    else
+        _impl->statisticsTimer.stop();
+}
+
 void Server::requestFrame(const QString uri)
 {
     _impl->frameDispatcher->requestFrame(uri);
 }
 
+void Server::setBufferPolicy(const QString uri, const BufferPolicy policy)
+{
+    _impl->frameDispatcher->setBufferPolicy(uri, policy);
+}
+
+void Server::setStreamMemoryBudget(const QString uri, const size_t bytes)
+{
+    _impl->frameDispatcher->setStreamMemoryBudget(uri, bytes);
+}
+
 void Server::closePixelStream(const QString uri)
 {
     emit _closePixelStream(uri);
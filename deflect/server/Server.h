@@ -43,6 +43,7 @@
 
 #include <deflect/SizeHints.h>
 #include <deflect/api.h>
+#include <deflect/server/Statistics.h>
 #include <deflect/server/types.h>
 
 #include <QObject>
@@ -81,6 +82,83 @@ public:
     /** @return the port on which the server is running. */
     quint16 getPort() const;
 
+    /**
+     * Get the number of frames of a stream that were dropped by the server.
+     *
+     * Frames are dropped when newer frames are complete before the previous
+     * ones could be dispatched, see requestFrame() and setBufferPolicy().
+     *
+     * @param uri Identifier for the stream
+     * @return the number of complete frames dropped since the stream opened
+     */
+    size_t getDroppedFrameCount(const QString& uri) const;
+
+    /**
+     * Set the maximum memory used to buffer the frames of all streams.
+     *
+     * When the budget is exceeded, the older complete frames of all streams
+     * are released. If it is still exceeded, the stream which received the
+     * last frame is closed and pixelStreamException() is emitted.
+     *
+     * @param bytes The memory budget in bytes, 0 for unlimited (default)
+     */
+    void setMemoryBudget(size_t bytes);
+
+    /**
+     * Decode the JPEG tiles on a pool of threads as soon as they are received.
+     *
+     * Decoding overlaps with the reception of the rest of the frame, so that
+     * receivedFrame() delivers tiles which are already decoded. Uncompressed
+     * tiles are left untouched.
+     *
+     * The setting applies to the streams which connect after the call.
+     *
+     * @param mode The decoding to apply, TileDecoding::none by default
+     * @param threadCount The maximum number of decoding threads, or 0 to use
+     *        QThread::idealThreadCount()
+     * @throw std::invalid_argument if the requested decoding is not supported
+     *        by the libjpeg-turbo version that Deflect was built with
+     */
+    void setTileDecoding(TileDecoding mode, int threadCount = 0);
+
+    /**
+     * Record the frames dispatched for all streams to an archive.
+     *
+     * The frames are recorded as they are emitted by receivedFrame(); they are
+     * written to disk by a background thread, which does not delay the
+     * dispatching. Frames are dropped if the disk can not keep up. The tiles
+     * are recorded in their dispatched format, i.e. uncompressed when they are
+     * decoded by the Server (see setTileDecoding()). The archive can be read
+     * back with FrameArchive.
+     *
+     * @param filename The archive data file, the index file is created next to
+     *        it. Existing files are overwritten.
+     * @throw std::runtime_error if the archive could not be created
+     */
+    void startRecording(const QString& filename);
+
+    /** Stop recording, writing all pending frames to the archive. */
+    void stopRecording();
+
+    /**
+     * Sample the statistics of all the open pixel streams.
+     *
+     * The counters are maintained without locking by the network threads and
+     * the frame dispatching. The rates are averaged since the previous sample,
+     * which is taken either by this function or by the periodic update.
+     *
+     * @return the statistics of each stream
+     * @see setStatisticsInterval()
+     */
+    Statistics getStatistics();
+
+    /**
+     * Periodically sample the statistics and emit statisticsUpdated().
+     *
+     * @param milliseconds The update interval, 0 to disable (default)
+     */
+    void setStatisticsInterval(int milliseconds);
+
 public slots:
     /**
      * Request the dispatching of the next frame for a given pixel stream.
@@ -95,6 +173,37 @@ public slots:
      */
     void requestFrame(QString uri);
 
+    /**
+     * Set the buffering policy for the frames of a pixel stream.
+     *
+     * By default, all complete frames are kept until the next requestFrame(),
+     * which only dispatches the latest one. For streams of large images, using
+     * BufferPolicy::latest_frame releases the older frames as soon as a newer
+     * one is complete, bounding the memory to about two frames per source.
+     *
+     * The policy can be set once pixelStreamOpened() has been emitted and
+     * remains active until the stream is closed.
+     *
+     * @param uri Identifier for the stream
+     * @param policy The buffering policy
+     */
+    void setBufferPolicy(QString uri, deflect::server::BufferPolicy policy);
+
+    /**
+     * Set the maximum memory used to buffer the frames of a pixel stream.
+     *
+     * When the budget is exceeded, the older complete frames of the stream are
+     * released. If it is still exceeded, the stream is closed and
+     * pixelStreamException() is emitted.
+     *
+     * The budget can be set once pixelStreamOpened() has been emitted and
+     * remains active until the stream is closed.
+     *
+     * @param uri Identifier for the stream
+     * @param bytes The memory budget in bytes, 0 for unlimited (default)
+     */
+    void setStreamMemoryBudget(QString uri, size_t bytes);
+
     /**
      * Close a pixel stream, disconnecting the remote client.
      *
@@ -165,6 +274,14 @@ signals:
      */
     void receivedData(QString uri, QByteArray data);
 
+    /**
+     * Emitted periodically with the statistics of all the open pixel streams.
+     *
+     * @param statistics The statistics of each stream
+     * @see setStatisticsInterval()
+     */
+    void statisticsUpdated(deflect::server::Statistics statistics);
+
 private:
     class Impl;
     std::unique_ptr<Impl> _impl;
@@ -172,6 +289,8 @@ private:
 signals:
     /** @internal */
     void _closePixelStream(QString uri);
+    /** @internal */
+    void _frameDispatched(QString uri);
 };
 }
 }
@@ -40,10 +40,20 @@
 
 #include "ServerWorker.h"
 
+#include "TileQueue.h"
 #include "deflect/NetworkProtocol.h"
 #include "deflect/SegmentParameters.h"
+#include "deflect/Tracer.h"
+#include "deflect/defines.h"
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include "TileDecoder.h"
+#endif
 
 #include <QDataStream>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentRun>
 
 #include <cstdint>
 #include <stdexcept>
@@ -51,6 +61,7 @@
 namespace
 {
 const int RECEIVE_TIMEOUT_MS = 3000;
+const int CLOCK_PING_INTERVAL_MS = 1000;
 
 class protocol_error : public std::runtime_error
 {
@@ -62,6 +73,30 @@ bool _isProtocolStart(const deflect::MessageType messageType)
     return messageType == deflect::MESSAGE_TYPE_PIXELSTREAM_OPEN ||
            messageType == deflect::MESSAGE_TYPE_OBSERVER_OPEN;
 }
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+deflect::server::Tile _decode(
+    deflect::server::Tile tile, const deflect::server::TileDecoding mode,
+    std::shared_ptr<deflect::server::BufferPool> bufferPool)
+{
+    // One decoder (and libjpeg-turbo handle) per thread of the pool
+    thread_local deflect::server::TileDecoder decoder;
+    decoder.setBufferPool(bufferPool); // shared by all the connections
+
+    // The received data is no longer needed once the tile is decoded
+    auto receivedData = tile.imageData;
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+    if (mode == deflect::server::TileDecoding::yuv)
+        decoder.decodeToYUV(tile);
+    else
+#else
+    Q_UNUSED(mode);
+#endif
+        decoder.decode(tile);
+    bufferPool->release(std::move(receivedData));
+    return tile;
+}
+#endif
 }
 
 namespace deflect
@@ -71,6 +106,7 @@ namespace server
 ServerWorker::ServerWorker(const int socketDescriptor)
     : _tcpSocket{new QTcpSocket(this)} // Ensure that _tcpSocket parent is
                                        // *this* so it gets moved to thread
+    , _clockPingTimer{new QTimer(this)}
     , _sourceId{socketDescriptor}
     , _clientProtocolVersion{NETWORK_PROTOCOL_VERSION}
 {
@@ -87,6 +123,10 @@ ServerWorker::ServerWorker(const int socketDescriptor)
             &ServerWorker::_processMessages, Qt::QueuedConnection);
     connect(this, &ServerWorker::_dataAvailable, this,
             &ServerWorker::_processMessages, Qt::QueuedConnection);
+
+    _clockPingTimer->setInterval(CLOCK_PING_INTERVAL_MS);
+    connect(_clockPingTimer, &QTimer::timeout, this,
+            &ServerWorker::_sendClockPing);
 }
 
 ServerWorker::~ServerWorker()
@@ -95,17 +135,32 @@ ServerWorker::~ServerWorker()
     // We still want to remove this source so that the stream does not get stuck
     // if other senders are still active / resp. the window gets closed if no
     // more senders contribute to it.
-    if (_isProtocolStarted())
-        _notifyProtocolEnd();
+    for (const auto& source : _sources)
+        _notifyProtocolEnd(source.first, source.second);
 
     if (_isConnected())
         _sendQuit();
 }
 
+void ServerWorker::setTileDecoding(const TileDecoding mode,
+                                   QThreadPool* threadPool)
+{
+    _tileDecoding = mode;
+    _decodingThreadPool = threadPool;
+}
+
+void ServerWorker::setBufferPool(std::shared_ptr<BufferPool> pool)
+{
+    _bufferPool = std::move(pool);
+}
+
 void ServerWorker::processEvent(const Event evt)
 {
-    _events.emplace_back(evt);
-    emit _dataAvailable();
+    // A single wakeup sends all the events queued until then
+    const bool wakeup = _events.empty();
+    _events.push(evt);
+    if (wakeup)
+        emit _dataAvailable();
 }
 
 void ServerWorker::initConnection()
@@ -115,14 +170,43 @@ void ServerWorker::initConnection()
 
 void ServerWorker::closeConnections(const QString uri)
 {
-    if (uri == _streamId)
-        _terminateConnection();
+    _closeSource(uri);
 }
 
 void ServerWorker::closeConnection(const QString uri, const size_t sourceIndex)
 {
-    if (uri == _streamId && sourceIndex == (size_t)_sourceId)
+    if (sourceIndex == (size_t)_sourceId)
+        _closeSource(uri);
+}
+
+void ServerWorker::grantFrameCredit(const QString uri)
+{
+    const auto it = _sources.find(uri);
+    if (it != _sources.end() && it->second.frameCredits)
+        _sendFrameCredits(uri, 1);
+}
+
+void ServerWorker::_closeSource(const QString& uri)
+{
+    const auto it = _sources.find(uri);
+    if (it == _sources.end())
+        return;
+
+    // Other streams multiplexed over the connection keep it open
+    if (_sources.size() == 1)
+    {
         _terminateConnection();
+        return;
+    }
+    _notifyProtocolEnd(it->first, it->second);
+    _sources.erase(it);
+
+    if (uri == _streamId && _registeredToEvents)
+    {
+        _sendCloseEvent();
+        _registeredToEvents = false;
+    }
+    _sendStreamClosed(uri);
 }
 
 void ServerWorker::_terminateConnection()
@@ -154,9 +238,15 @@ void ServerWorker::_processMessages()
 
 void ServerWorker::_receiveMessage()
 {
+    const TraceScope trace{"server", "receiveMessage"};
     try
     {
         const auto messageHeader = _receiveMessageHeader();
+        if (messageHeader.type == MESSAGE_TYPE_PIXELSTREAM)
+        {
+            _receiveTile(messageHeader);
+            return;
+        }
         const auto messageBody = _receiveMessageBody(messageHeader.size);
         _handleMessage(messageHeader, messageBody);
     }
@@ -197,6 +287,54 @@ QByteArray ServerWorker::_receiveMessageBody(const int size)
     return messageData;
 }
 
+void ServerWorker::_receiveTile(const MessageHeader& messageHeader)
+{
+    _validate(messageHeader.type);
+
+    const auto paramsSize = sizeof(SegmentParameters);
+    if (messageHeader.size < paramsSize)
+        throw protocol_error("Invalid pixel stream message size");
+
+    SegmentParameters params;
+    _receiveData(reinterpret_cast<char*>(&params), paramsSize);
+
+    // Tiles of a stream closed by the server are read but discarded
+    const auto source = _findSource(messageHeader.uri);
+
+    // Read the image data directly into a (reused) buffer instead of copying
+    // it out of the message body.
+    auto imageData = _bufferPool->acquire(messageHeader.size - paramsSize);
+    _receiveData(imageData.data(), imageData.size());
+
+    if (source == _sources.end() || !source->second.tileQueue)
+    {
+        _bufferPool->release(std::move(imageData));
+        return;
+    }
+    source->second.tileQueue->addReceivedBytes(MessageHeader::serializedSize +
+                                               messageHeader.size);
+    _pushTile(source->second,
+              _makeTile(source->second, params, std::move(imageData)));
+}
+
+void ServerWorker::_receiveData(char* data, const qint64 size)
+{
+    qint64 received = 0;
+    while (received < size)
+    {
+        const auto count = _tcpSocket->read(data + received, size - received);
+        if (count < 0)
+            throw std::runtime_error("Error reading message data");
+
+        received += count;
+        if (received < size &&
+            !_tcpSocket->waitForReadyRead(RECEIVE_TIMEOUT_MS))
+        {
+            throw std::runtime_error("Timeout reading message data");
+        }
+    }
+}
+
 bool ServerWorker::_socketHasMessage() const
 {
     return _tcpSocket->bytesAvailable() >=
@@ -208,44 +346,60 @@ void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
 {
     _validate(messageHeader.type);
 
-    switch (messageHeader.type)
+    if (_isProtocolStart(messageHeader.type))
     {
-    case MESSAGE_TYPE_PIXELSTREAM_OPEN:
-        _startProtocol(messageHeader.uri, byteArray, false);
-        break;
+        const bool observer = messageHeader.type == MESSAGE_TYPE_OBSERVER_OPEN;
+        _startProtocol(messageHeader.uri, byteArray, observer);
+        return;
+    }
 
-    case MESSAGE_TYPE_OBSERVER_OPEN:
-        _startProtocol(messageHeader.uri, byteArray, true);
-        break;
+    // The clock offset is measured for the whole connection
+    if (messageHeader.type == MESSAGE_TYPE_CLOCK_PONG)
+    {
+        _receiveClockPong(byteArray);
+        return;
+    }
+
+    // Messages of a stream closed by the server are discarded
+    const auto it = _findSource(messageHeader.uri);
+    if (it == _sources.end())
+        return;
+
+    const auto& uri = it->first;
+    auto& source = it->second;
 
+    switch (messageHeader.type)
+    {
     case MESSAGE_TYPE_QUIT:
-        _stopProtocol();
+        _stopProtocol(uri);
         break;
 
     case MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME:
-        emit receivedFrameFinished(_streamId, _sourceId);
-        break;
-
-    case MESSAGE_TYPE_PIXELSTREAM:
-        emit receivedTile(_streamId, _sourceId, _parseTile(byteArray));
+        if (source.tileQueue)
+        {
+            const auto trace = _makeFrameTrace(byteArray);
+            _pushDecodedTiles(source);
+            source.tileQueue->pushFrameFinished(trace);
+            emit receivedFrameFinished(uri, _sourceId);
+        }
         break;
 
     case MESSAGE_TYPE_SIZE_HINTS:
     {
         const auto hints = reinterpret_cast<const SizeHints*>(byteArray.data());
-        emit receivedSizeHints(_streamId, *hints);
+        emit receivedSizeHints(uri, *hints);
         break;
     }
 
     case MESSAGE_TYPE_DATA:
-        emit receivedData(_streamId, byteArray);
+        emit receivedData(uri, byteArray);
         break;
 
     case MESSAGE_TYPE_IMAGE_VIEW:
     {
         const auto view = reinterpret_cast<const View*>(byteArray.data());
         if (*view >= View::mono && *view <= View::right_eye)
-            _activeView = *view;
+            source.activeView = *view;
         break;
     }
 
@@ -253,14 +407,14 @@ void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
     {
         const auto order = reinterpret_cast<const RowOrder*>(byteArray.data());
         if (*order >= RowOrder::top_down && *order <= RowOrder::bottom_up)
-            _activeRowOrder = *order;
+            source.activeRowOrder = *order;
         break;
     }
 
     case MESSAGE_TYPE_IMAGE_CHANNEL:
     {
         const auto channel = reinterpret_cast<const uint8_t*>(byteArray.data());
-        _activeChannel = *channel;
+        source.activeChannel = *channel;
         break;
     }
 
@@ -268,11 +422,18 @@ void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
     case MESSAGE_TYPE_BIND_EVENTS_EX:
     {
         const auto excl = messageHeader.type == MESSAGE_TYPE_BIND_EVENTS_EX;
-        _tryRegisteringForEvents(excl);
+        _tryRegisteringForEvents(uri, excl);
         _sendBindReply(_registeredToEvents);
         break;
     }
 
+    case MESSAGE_TYPE_ENABLE_FRAME_CREDITS:
+        // The first credit lets the stream send its first frame
+        if (!source.frameCredits)
+            _sendFrameCredits(uri, 1);
+        source.frameCredits = true;
+        break;
+
     default:
         break;
     }
@@ -292,8 +453,14 @@ void ServerWorker::_startProtocol(const QString& uri,
                                   const QByteArray& byteArray,
                                   const bool observer)
 {
-    if (_isProtocolStarted())
+    // Clients multiplex further streams over the connection since protocol
+    // version 11, each one tagged by its uri.
+    if (_isProtocolStarted() &&
+        (_clientProtocolVersion < MULTIPLEXING_PROTOCOL_VERSION ||
+         _sources.count(uri)))
+    {
         throw protocol_error("Stream protocol was started already");
+    }
 
     if (uri.isEmpty())
         throw protocol_error("Can't init stream protocol with empty stream id");
@@ -301,38 +468,69 @@ void ServerWorker::_startProtocol(const QString& uri,
     if (_protocolEnded)
         throw protocol_error("Stream protocol cannot be restarted once ended");
 
-    _streamId = uri;
-    _observer = observer;
+    if (_streamId.isEmpty())
+        _streamId = uri;
     _parseClientProtocolVersion(byteArray);
 
-    if (_observer)
-        emit addObserver(_streamId);
+    auto& source = _sources[uri];
+    source.observer = observer;
+    if (observer)
+        emit addObserver(uri);
     else
-        emit addStreamSource(_streamId, _sourceId);
+    {
+        source.tileQueue = std::make_shared<TileQueue>();
+        if (_clockOffset.isValid())
+        {
+            source.tileQueue->setClockOffset(_clockOffset.getOffset(),
+                                             _clockOffset.getRoundTripTime());
+        }
+        emit addStreamSource(uri, _sourceId, source.tileQueue);
+
+        if (_clientProtocolVersion >= CLOCK_SYNC_PROTOCOL_VERSION &&
+            !_clockPingTimer->isActive())
+        {
+            _sendClockPing();
+            _clockPingTimer->start();
+        }
+    }
 }
 
-void ServerWorker::_stopProtocol()
+void ServerWorker::_stopProtocol(const QString& uri)
 {
-    if (!_isProtocolStarted())
+    const auto it = _sources.find(uri);
+    if (it == _sources.end())
         throw protocol_error("Stream protocol had already ended");
 
-    _notifyProtocolEnd();
+    _notifyProtocolEnd(it->first, it->second);
+    _sources.erase(it);
 
-    _streamId = QString();
-    _protocolEnded = true;
+    if (_sources.empty())
+        _protocolEnded = true;
 }
 
-void ServerWorker::_notifyProtocolEnd()
+void ServerWorker::_notifyProtocolEnd(const QString& uri, const Source& source)
 {
-    if (_observer)
-        emit removeObserver(_streamId);
+    if (source.observer)
+        emit removeObserver(uri);
     else
-        emit removeStreamSource(_streamId, _sourceId);
+        emit removeStreamSource(uri, _sourceId);
 }
 
 bool ServerWorker::_isProtocolStarted() const
 {
-    return !_streamId.isEmpty();
+    return !_sources.empty();
+}
+
+std::map<QString, ServerWorker::Source>::iterator ServerWorker::_findSource(
+    const QString& uri)
+{
+    // Clients before protocol version 11 use a single stream per connection
+    if (_clientProtocolVersion < MULTIPLEXING_PROTOCOL_VERSION &&
+        _sources.size() == 1)
+    {
+        return _sources.begin();
+    }
+    return _sources.find(uri);
 }
 
 void ServerWorker::_parseClientProtocolVersion(const QByteArray& message)
@@ -347,30 +545,101 @@ void ServerWorker::_parseClientProtocolVersion(const QByteArray& message)
         _clientProtocolVersion = version;
 }
 
-Tile ServerWorker::_parseTile(const QByteArray& message) const
+FrameTrace ServerWorker::_makeFrameTrace(const QByteArray& message) const
+{
+    FrameTrace trace;
+    trace.receiveTime = currentTimestamp();
+
+    // FrameInfo is only sent by clients since protocol version 9
+    if (message.size() >= int(sizeof(FrameInfo)))
+    {
+        const auto info = reinterpret_cast<const FrameInfo*>(message.data());
+        trace.frameNumber = info->frameNumber;
+        trace.sendTime = _clockOffset.toServerTime(info->timestamp);
+    }
+    return trace;
+}
+
+void ServerWorker::_receiveClockPong(const QByteArray& message)
+{
+    if (message.size() < int(sizeof(ClockPing)))
+        throw protocol_error("Invalid clock pong message size");
+
+    const auto ping = reinterpret_cast<const ClockPing*>(message.data());
+    _clockOffset.addRoundTrip(ping->serverTime, ping->clientTime,
+                              currentTimestamp());
+
+    for (auto& kv : _sources)
+    {
+        if (kv.second.tileQueue)
+        {
+            kv.second.tileQueue->setClockOffset(
+                _clockOffset.getOffset(), _clockOffset.getRoundTripTime());
+        }
+    }
+}
+
+Tile ServerWorker::_makeTile(const Source& source,
+                             const SegmentParameters& params,
+                             QByteArray&& imageData) const
 {
     Tile tile;
 
-    const auto data = message.data();
-    const auto params = reinterpret_cast<const SegmentParameters*>(data);
-    tile.format = params->format;
-    tile.x = params->x;
-    tile.y = params->y;
-    tile.width = params->width;
-    tile.height = params->height;
-    tile.imageData = message.right(message.size() - sizeof(SegmentParameters));
-    tile.view = _activeView;
-    tile.rowOrder = _activeRowOrder;
-    tile.channel = _activeChannel;
+    tile.format = params.format;
+    tile.x = params.x;
+    tile.y = params.y;
+    tile.width = params.width;
+    tile.height = params.height;
+    tile.imageData = std::move(imageData);
+    tile.view = source.activeView;
+    tile.rowOrder = source.activeRowOrder;
+    tile.channel = source.activeChannel;
 
     return tile;
 }
 
-void ServerWorker::_tryRegisteringForEvents(const bool exclusive)
+void ServerWorker::_pushTile(Source& source, Tile&& tile)
+{
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    if (_tileDecoding != TileDecoding::none && tile.format == Format::jpeg)
+    {
+        // Decode while the rest of the frame is being received; the decoded
+        // tiles are queued once the frame is finished.
+        source.decodingTiles.emplace_back(
+            QtConcurrent::run(_decodingThreadPool, _decode, std::move(tile),
+                              _tileDecoding, _bufferPool));
+        return;
+    }
+#endif
+    source.tileQueue->push(std::move(tile));
+}
+
+void ServerWorker::_pushDecodedTiles(Source& source)
+{
+    try
+    {
+        for (auto& future : source.decodingTiles)
+            source.tileQueue->push(future.result());
+    }
+    catch (const QUnhandledException&)
+    {
+        // QtConcurrent::run can only forward QException subclasses, see
+        // TileDecoder::waitDecoding().
+        source.decodingTiles.clear();
+        throw std::runtime_error("Tile decoding failed");
+    }
+    source.decodingTiles.clear();
+}
+
+void ServerWorker::_tryRegisteringForEvents(const QString& uri,
+                                            const bool exclusive)
 {
     if (_registeredToEvents)
         throw protocol_error("The stream has already registered for events");
 
+    if (uri != _streamId)
+        throw protocol_error("Only the first stream can register for events");
+
     auto promise = std::make_shared<std::promise<bool>>();
     auto future = promise->get_future();
 
@@ -394,9 +663,21 @@ void ServerWorker::_sendProtocolVersion()
 
 void ServerWorker::_sendPendingEvents()
 {
-    for (const auto& evt : _events)
-        _send(evt);
-    _events.clear();
+    if (_events.empty())
+        return;
+
+    const TraceScope trace{"server", "sendEvents"};
+    const auto events = _events.takeAll();
+    if (events.size() > 1 &&
+        _clientProtocolVersion >= EVENT_BATCH_PROTOCOL_VERSION)
+    {
+        _send(events);
+    }
+    else
+    {
+        for (const auto& evt : events)
+            _send(evt);
+    }
     _flushSocket();
 }
 
@@ -409,17 +690,55 @@ void ServerWorker::_sendBindReply(const bool successful)
     _flushSocket();
 }
 
+void ServerWorker::_sendClockPing()
+{
+    if (_sources.empty() || !_isConnected())
+    {
+        _clockPingTimer->stop();
+        return;
+    }
+
+    ClockPing ping;
+    ping.serverTime = currentTimestamp();
+
+    MessageHeader mh(MESSAGE_TYPE_CLOCK_PING, sizeof(ClockPing),
+                     _streamId.toStdString());
+    _send(mh);
+
+    _tcpSocket->write((const char*)&ping, sizeof(ClockPing));
+    _flushSocket();
+}
+
+void ServerWorker::_sendFrameCredits(const QString& uri,
+                                     const uint32_t credits)
+{
+    MessageHeader mh(MESSAGE_TYPE_FRAME_CREDITS, sizeof(uint32_t),
+                     uri.toStdString());
+    _send(mh);
+
+    _tcpSocket->write((const char*)&credits, sizeof(uint32_t));
+    _flushSocket();
+}
+
 void ServerWorker::_send(const Event& evt)
 {
     // send message header
     MessageHeader mh(MESSAGE_TYPE_EVENT, Event::serializedSize);
     _send(mh);
 
-    {
-        QDataStream stream(_tcpSocket);
+    QDataStream stream(_tcpSocket);
+    stream << evt;
+}
+
+void ServerWorker::_send(const std::vector<Event>& events)
+{
+    MessageHeader mh(MESSAGE_TYPE_EVENT_BATCH,
+                     uint32_t(events.size() * Event::serializedSize));
+    _send(mh);
+
+    QDataStream stream(_tcpSocket);
+    for (const auto& evt : events)
         stream << evt;
-    }
-    _flushSocket();
 }
 
 void ServerWorker::_sendCloseEvent()
@@ -427,6 +746,14 @@ void ServerWorker::_sendCloseEvent()
     Event closeEvent;
     closeEvent.type = Event::EVT_CLOSE;
     _send(closeEvent);
+    _flushSocket();
+}
+
+void ServerWorker::_sendStreamClosed(const QString& uri)
+{
+    MessageHeader mh(MESSAGE_TYPE_STREAM_CLOSED, 0, uri.toStdString());
+    _send(mh);
+    _flushSocket();
 }
 
 void ServerWorker::_sendQuit()
@@ -42,13 +42,25 @@
 #define DEFLECT_SERVER_SERVERWORKER_H
 
 #include <deflect/Event.h>
+#include <deflect/FrameInfo.h>
 #include <deflect/MessageHeader.h>
+#include <deflect/SegmentParameters.h>
 #include <deflect/SizeHints.h>
+#include <deflect/server/BufferPool.h>
+#include <deflect/server/ClockOffset.h>
+#include <deflect/server/EventQueue.h>
 #include <deflect/server/EventReceiver.h>
-#include <deflect/server/Tile.h>
+#include <deflect/server/Frame.h>
 
+#include <QFuture>
 #include <QtNetwork/QTcpSocket>
 
+#include <map>
+#include <memory>
+
+class QThreadPool;
+class QTimer;
+
 namespace deflect
 {
 namespace server
@@ -61,6 +73,15 @@ public:
     explicit ServerWorker(int socketDescriptor);
     ~ServerWorker();
 
+    /** Decode the received JPEG tiles on the given pool of threads. */
+    void setTileDecoding(TileDecoding mode, QThreadPool* threadPool);
+
+    /**
+     * Receive the tiles into buffers of the given pool, which is shared with
+     * the FrameDispatcher that gives them back once the frames are consumed.
+     */
+    void setBufferPool(std::shared_ptr<BufferPool> pool);
+
 public slots:
     void processEvent(Event evt) final;
 
@@ -68,15 +89,17 @@ public slots:
     void closeConnections(QString uri);
     void closeConnection(QString uri, size_t sourceIndex);
 
+    /** Grant a frame credit to the stream if it asked for them. */
+    void grantFrameCredit(QString uri);
+
 signals:
-    void addStreamSource(QString uri, size_t sourceIndex);
+    void addStreamSource(QString uri, size_t sourceIndex,
+                         deflect::server::TileQueuePtr queue);
     void removeStreamSource(QString uri, size_t sourceIndex);
 
     void addObserver(QString uri);
     void removeObserver(QString uri);
 
-    void receivedTile(QString uri, size_t sourceIndex,
-                      deflect::server::Tile tile);
     void receivedFrameFinished(QString uri, size_t sourceIndex);
     void registerToEvents(QString uri, bool exclusive,
                           deflect::server::EventReceiver* receiver,
@@ -96,27 +119,48 @@ private slots:
     void _processMessages();
 
 private:
-    QTcpSocket* _tcpSocket = nullptr; // child QObject
+    QTcpSocket* _tcpSocket = nullptr;     // child QObject
+    QTimer* _clockPingTimer = nullptr; // child QObject
     const int _sourceId;
 
+    /** A stream (or observer) multiplexed over the connection. */
+    struct Source
+    {
+        bool observer = false;
+        bool frameCredits = false;
+        TileQueuePtr tileQueue;
+        std::vector<QFuture<Tile>> decodingTiles;
+
+        View activeView = View::mono;
+        RowOrder activeRowOrder = RowOrder::top_down;
+        uint8_t activeChannel = 0;
+    };
+
+    /** The first stream opened, to which the events are bound. */
     QString _streamId;
     int _clientProtocolVersion;
-    bool _observer = false;
+    std::map<QString, Source> _sources;
+    std::shared_ptr<BufferPool> _bufferPool{std::make_shared<BufferPool>()};
 
-    bool _registeredToEvents = false;
-    std::vector<Event> _events;
+    TileDecoding _tileDecoding = TileDecoding::none;
+    QThreadPool* _decodingThreadPool = nullptr;
 
-    View _activeView = View::mono;
-    RowOrder _activeRowOrder = RowOrder::top_down;
-    uint8_t _activeChannel = 0;
+    bool _registeredToEvents = false;
+    EventQueue _events;
 
     bool _protocolEnded = false;
 
+    /** Offset of the client clock, for clients using protocol version 13 */
+    ClockOffset _clockOffset;
+
     void _terminateConnection();
+    void _closeSource(const QString& uri);
 
     void _receiveMessage();
     MessageHeader _receiveMessageHeader();
     QByteArray _receiveMessageBody(int size);
+    void _receiveTile(const MessageHeader& messageHeader);
+    void _receiveData(char* data, qint64 size);
 
     bool _socketHasMessage() const;
     void _handleMessage(const MessageHeader& messageHeader,
@@ -124,20 +168,30 @@ private:
     void _validate(MessageType messageType) const;
     void _startProtocol(const QString& uri, const QByteArray& byteArray,
                         bool observer);
-    void _stopProtocol();
-    void _notifyProtocolEnd();
+    void _stopProtocol(const QString& uri);
+    void _notifyProtocolEnd(const QString& uri, const Source& source);
     bool _isProtocolStarted() const;
+    std::map<QString, Source>::iterator _findSource(const QString& uri);
 
     void _parseClientProtocolVersion(const QByteArray& message);
-    Tile _parseTile(const QByteArray& message) const;
+    FrameTrace _makeFrameTrace(const QByteArray& message) const;
+    void _receiveClockPong(const QByteArray& message);
+    Tile _makeTile(const Source& source, const SegmentParameters& params,
+                   QByteArray&& imageData) const;
+    void _pushTile(Source& source, Tile&& tile);
+    void _pushDecodedTiles(Source& source);
 
-    void _tryRegisteringForEvents(bool exclusive);
+    void _tryRegisteringForEvents(const QString& uri, bool exclusive);
 
     void _sendProtocolVersion();
     void _sendPendingEvents();
     void _sendBindReply(bool successful);
+    void _sendClockPing();
+    void _sendFrameCredits(const QString& uri, uint32_t credits);
     void _send(const Event& evt);
+    void _send(const std::vector<Event>& events);
     void _sendCloseEvent();
+    void _sendStreamClosed(const QString& uri);
     void _sendQuit();
     bool _send(const MessageHeader& messageHeader);
     void _flushSocket();
@@ -39,20 +39,27 @@
 
 #include "SourceBuffer.h"
 
-#include <exception>
+#include <algorithm>
+#include <iterator>
 
 namespace deflect
 {
 namespace server
 {
 SourceBuffer::SourceBuffer()
+    : _slots(1)
+    , _size(1)
 {
-    _tiles.push(Tiles());
 }
 
 const Tiles& SourceBuffer::getTiles() const
 {
-    return _tiles.front();
+    return _slots[_front].tiles;
+}
+
+const FrameTrace& SourceBuffer::getFrameTrace() const
+{
+    return _slots[_front].trace;
 }
 
 FrameIndex SourceBuffer::getBackFrameIndex() const
@@ -62,28 +69,85 @@ FrameIndex SourceBuffer::getBackFrameIndex() const
 
 bool SourceBuffer::isBackFrameEmpty() const
 {
-    return _tiles.back().empty();
+    return _back().tiles.empty();
 }
 
 void SourceBuffer::pop()
 {
-    _tiles.pop();
+    _clearFront();
+}
+
+void SourceBuffer::pop(Tiles& tiles)
+{
+    auto& front = _slots[_front].tiles;
+    if (tiles.empty())
+        std::swap(tiles, front); // the slot keeps the capacity of the list
+    else
+        tiles.insert(tiles.end(), std::make_move_iterator(front.begin()),
+                     std::make_move_iterator(front.end()));
+    _clearFront();
 }
 
-void SourceBuffer::push()
+void SourceBuffer::push(const FrameTrace& trace)
 {
-    _tiles.push(Tiles());
+    _back().trace = trace;
+
+    if (_size == _slots.size())
+    {
+        // Grow the ring, moving the front slot to the beginning to keep order
+        std::rotate(_slots.begin(), _slots.begin() + _front, _slots.end());
+        _front = 0;
+        _slots.emplace_back();
+    }
+    ++_size;
     ++_backFrameIndex;
 }
 
 void SourceBuffer::insert(const Tile& tile)
 {
-    _tiles.back().push_back(tile);
+    auto& back = _back();
+    back.tiles.push_back(tile);
+    back.byteCount += tile.imageData.size();
+    _byteCount += tile.imageData.size();
+}
+
+void SourceBuffer::insert(Tile&& tile)
+{
+    auto& back = _back();
+    back.byteCount += tile.imageData.size();
+    _byteCount += tile.imageData.size();
+    back.tiles.push_back(std::move(tile));
 }
 
 size_t SourceBuffer::getQueueSize() const
 {
-    return _tiles.size();
+    return _size;
+}
+
+size_t SourceBuffer::getByteCount() const
+{
+    return _byteCount;
+}
+
+SourceBuffer::Slot& SourceBuffer::_back()
+{
+    return _slots[(_front + _size - 1) % _slots.size()];
+}
+
+const SourceBuffer::Slot& SourceBuffer::_back() const
+{
+    return _slots[(_front + _size - 1) % _slots.size()];
+}
+
+void SourceBuffer::_clearFront()
+{
+    auto& front = _slots[_front];
+    _byteCount -= front.byteCount;
+    front.byteCount = 0;
+    front.tiles.clear(); // keeps capacity for reuse
+    front.trace = FrameTrace();
+    _front = (_front + 1) % _slots.size();
+    --_size;
 }
 }
 }
@@ -40,10 +40,9 @@
 #ifndef DEFLECT_SERVER_SOURCEBUFFER_H
 #define DEFLECT_SERVER_SOURCEBUFFER_H
 
-#include <deflect/server/Tile.h>
+#include <deflect/server/Frame.h>
 
-#include <array>
-#include <queue>
+#include <vector>
 
 namespace deflect
 {
@@ -53,6 +52,9 @@ using FrameIndex = unsigned int;
 
 /**
  * Buffer for a single source of tiles.
+ *
+ * The frames are stored in a ring of slots which keep their allocated memory
+ * when they are popped, so that no allocations are needed in steady state.
  */
 class SourceBuffer
 {
@@ -72,21 +74,57 @@ public:
     /** Insert a tile into the back frame. */
     void insert(const Tile& tile);
 
-    /** Push a new frame to the back. */
-    void push();
+    /** Move a tile into the back frame. */
+    void insert(Tile&& tile);
+
+    /**
+     * Finish the back frame and push a new frame to the back.
+     * @param trace The trace of the finished frame
+     */
+    void push(const FrameTrace& trace = FrameTrace());
+
+    /** @return the trace of the front frame, once it has been finished. */
+    const FrameTrace& getFrameTrace() const;
 
     /** Pop the front frame. */
     void pop();
 
+    /**
+     * Pop the front frame, moving its tiles to the end of the given list.
+     *
+     * An empty list is swapped with the one of the front slot, which then
+     * reuses its capacity for a future frame.
+     */
+    void pop(Tiles& tiles);
+
     /** @return the size of the queue. */
     size_t getQueueSize() const;
 
+    /** @return the number of bytes of image data held by the buffer. */
+    size_t getByteCount() const;
+
 private:
-    /** The collections of tiles for each mono/left/right view. */
-    std::queue<Tiles> _tiles;
+    struct Slot
+    {
+        Tiles tiles;
+        size_t byteCount = 0;
+        FrameTrace trace;
+    };
+
+    /** The ring of frames, from _front to the back frame. */
+    std::vector<Slot> _slots;
+    size_t _front = 0;
+    size_t _size = 0;
 
     /** The current indices of the mono/left/right frame for this source. */
     FrameIndex _backFrameIndex = 0u;
+
+    /** The total number of bytes held in all the slots. */
+    size_t _byteCount = 0;
+
+    Slot& _back();
+    const Slot& _back() const;
+    void _clearFront();
 };
 }
 }
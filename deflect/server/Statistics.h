@@ -0,0 +1,179 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_STATISTICS_H
+#define DEFLECT_SERVER_STATISTICS_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QString>
+
+#include <array>
+#include <vector>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Histogram of latencies, in microseconds.
+ *
+ * Bucket i counts the samples in [2^i, 2^(i+1)[. The first bucket also counts
+ * the samples below 1 µs, including the negative ones which can result from an
+ * offset between the clocks of a client and the server.
+ */
+struct LatencyHistogram
+{
+    static const size_t bucketCount = 32;
+
+    std::array<uint64_t, bucketCount> buckets{{}}; //!< Samples per bucket
+    uint64_t samples = 0; //!< Total number of samples
+    int64_t min = 0;      //!< Lowest sample
+    int64_t max = 0;      //!< Highest sample
+    double mean = 0.0;    //!< Mean of the samples
+
+    /** Add a sample. */
+    DEFLECT_API void add(int64_t latency);
+
+    /**
+     * @param fraction The percentile to compute, in [0, 1]
+     * @return the upper bound of the bucket which contains the percentile,
+     *         limited to the highest sample; 0 if there are no samples.
+     */
+    DEFLECT_API int64_t getPercentile(double fraction) const;
+};
+
+/**
+ * Statistics of a single source (connection) of a pixel stream.
+ *
+ * The rates are averaged since the previous sample of the statistics, see
+ * Server::getStatistics().
+ */
+struct SourceStatistics
+{
+    size_t sourceIndex = 0; //!< Identifier for the source in the stream
+
+    /** @name Reception, counted by the network thread of the source */
+    //@{
+    uint64_t receivedBytes = 0;  //!< Bytes of tile messages received
+    uint64_t receivedTiles = 0;  //!< Number of tiles received
+    uint64_t receivedFrames = 0; //!< Number of frames finished by the source
+    double bytesPerSecond = 0.0;
+    double tilesPerSecond = 0.0;
+    double framesPerSecond = 0.0;
+    //@}
+
+    /** @name Buffering */
+    //@{
+    size_t queuedFrames = 0;  //!< Finished frames waiting for other sources
+    size_t bufferedBytes = 0; //!< Bytes of image data held for the source
+    //@}
+
+    /**
+     * @name Clock synchronization
+     *
+     * The server estimates the offset of the client clock from timestamped
+     * ping messages, which clients answer since network protocol version 13.
+     * The send time of the frames is converted to the server clock with it.
+     */
+    //@{
+    bool clockSynchronized = false; //!< True once the offset is estimated
+    int64_t clockOffset = 0;   //!< Client minus server time, in µs
+    int64_t roundTripTime = 0; //!< Of the ping which measured it, in µs
+    //@}
+};
+
+/**
+ * Statistics of a pixel stream, aggregating all of its sources.
+ *
+ * The rates are averaged since the previous sample of the statistics, see
+ * Server::getStatistics().
+ */
+struct StreamStatistics
+{
+    QString uri; //!< Identifier for the stream
+
+    /** @name Reception, summed over all sources */
+    //@{
+    uint64_t receivedBytes = 0;
+    uint64_t receivedTiles = 0;
+    double bytesPerSecond = 0.0;
+    double tilesPerSecond = 0.0;
+    //@}
+
+    /** @name Frames */
+    //@{
+    uint64_t completeFrames = 0;   //!< Frames finished by all sources
+    uint64_t dispatchedFrames = 0; //!< Frames emitted by receivedFrame()
+    uint64_t droppedFrames = 0;    //!< Complete frames never dispatched
+    double completeFramesPerSecond = 0.0;
+    double dispatchedFramesPerSecond = 0.0;
+    double droppedFramesPerSecond = 0.0;
+    //@}
+
+    /** @name Buffering */
+    //@{
+    size_t queuedFrames = 0;  //!< Complete frames waiting to be dispatched
+    size_t bufferedBytes = 0; //!< Bytes of image data held for the stream
+    //@}
+
+    /**
+     * @name Latency of the frames dispatched since the stream opened
+     *
+     * The latencies from the send time are only available for clients using
+     * network protocol version 9 or later, see Frame::trace. They are
+     * corrected by the clock offset of each source for clients using version
+     * 13 or later, see SourceStatistics::clockOffset. For older clients they
+     * include the offset between the clocks of the client and the server,
+     * which, plus the minimal network delay, is estimated by the lowest
+     * receiveLatency.
+     */
+    //@{
+    LatencyHistogram receiveLatency;  //!< From send to receive time
+    LatencyHistogram dispatchLatency; //!< From receive to dispatch time
+    LatencyHistogram totalLatency;    //!< From send to dispatch time
+    //@}
+
+    std::vector<SourceStatistics> sources; //!< Statistics of each source
+};
+}
+}
+
+#endif
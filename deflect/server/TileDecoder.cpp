@@ -39,13 +39,22 @@
 
 #include "TileDecoder.h"
 
+#include "Frame.h"
 #include "ImageJpegDecompressor.h"
 #include "Tile.h"
 
+#include "deflect/Tracer.h"
+
 #include <QFuture>
+#include <QThread>
+#include <QThreadPool>
 #include <QtConcurrentRun>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 namespace deflect
 {
@@ -60,6 +69,17 @@ public:
 
     /** Async image decoding future */
     QFuture<void> decodingFuture;
+
+    /** Optional pool of the buffers of the decoded tiles */
+    std::shared_ptr<BufferPool> bufferPool;
+
+    /** Additional decompressors for decoding frames, one per thread */
+    std::vector<std::unique_ptr<ImageJpegDecompressor>> decompressors;
+
+    /** Threads for decoding frames */
+    QThreadPool threadPool;
+
+    void decode(Frame& frame, unsigned int threads, bool skipRgbConversion);
 };
 
 TileDecoder::TileDecoder()
@@ -79,9 +99,15 @@ ChromaSubsampling TileDecoder::decodeType(const Tile& tile)
     return _impl->decompressor.decompressHeader(tile.imageData).subsampling;
 }
 
-size_t _getExpectedSize(const Format format, const Tile& tile)
+uint32_t _scaled(const uint32_t dimension, const unsigned int scale)
 {
-    const size_t imageSize = tile.height * tile.width;
+    return (dimension + scale - 1) / scale; // same as TJSCALED
+}
+
+size_t _getExpectedSize(const Format format, const uint32_t width,
+                        const uint32_t height)
+{
+    const size_t imageSize = height * width;
     switch (format)
     {
     case Format::rgba:
@@ -97,12 +123,29 @@ size_t _getExpectedSize(const Format format, const Tile& tile)
     };
 }
 
+void _cropRgba(QByteArray& data, const uint32_t width, const uint32_t newWidth,
+               const uint32_t newHeight)
+{
+    const auto rowSize = newWidth * 4;
+    if (newWidth != width)
+    {
+        for (uint32_t y = 1; y < newHeight; ++y)
+        {
+            std::memmove(data.data() + y * rowSize,
+                         data.constData() + y * width * 4, rowSize);
+        }
+    }
+    data.resize(newHeight * rowSize);
+}
+
 void _decodeTile(ImageJpegDecompressor* decompressor, Tile* tile,
                  const bool skipRgbConversion)
 {
     if (tile->format != Format::jpeg)
         return;
 
+    const TraceScope trace{"server", "decodeTile"};
+
     QByteArray decodedData;
     Format format;
     try
@@ -110,8 +153,8 @@ void _decodeTile(ImageJpegDecompressor* decompressor, Tile* tile,
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
         if (skipRgbConversion)
         {
-            const auto yuv = decompressor->decompressToYUV(tile->imageData);
-            decodedData = yuv.first;
+            auto yuv = decompressor->decompressToYUV(tile->imageData);
+            decodedData = std::move(yuv.first);
             switch (yuv.second)
             {
             case ChromaSubsampling::YUV444:
@@ -141,12 +184,64 @@ void _decodeTile(ImageJpegDecompressor* decompressor, Tile* tile,
         throw;
     }
 
-    const auto expectedSize = _getExpectedSize(format, *tile);
+    const auto scale = decompressor->getScale();
+    const auto width = _scaled(tile->width, scale);
+    const auto height = _scaled(tile->height, scale);
+
+    const auto expectedSize = _getExpectedSize(format, width, height);
     if (size_t(decodedData.size()) != expectedSize)
         throw std::runtime_error("unexpected tile size");
 
-    tile->imageData = decodedData;
+    // Each tile extends to the scaled start of the next one, so that they
+    // neither overlap nor leave gaps. The last column (row) of a tile which
+    // ends in the middle of a scaled pixel is drawn by the next tile instead.
+    const auto x = _scaled(tile->x, scale);
+    const auto y = _scaled(tile->y, scale);
+    const auto croppedWidth = _scaled(tile->x + tile->width, scale) - x;
+    const auto croppedHeight = _scaled(tile->y + tile->height, scale) - y;
+    if (croppedWidth != width || croppedHeight != height)
+    {
+        if (format != Format::rgba)
+            throw std::runtime_error("scaled YUV tile is not aligned");
+        _cropRgba(decodedData, width, croppedWidth, croppedHeight);
+    }
+
+    tile->imageData = std::move(decodedData);
     tile->format = format;
+    tile->x = x;
+    tile->y = y;
+    tile->width = croppedWidth;
+    tile->height = croppedHeight;
+}
+
+void TileDecoder::setScale(const unsigned int denominator)
+{
+    _impl->decompressor.setScale(denominator);
+}
+
+unsigned int TileDecoder::getScale() const
+{
+    return _impl->decompressor.getScale();
+}
+
+void TileDecoder::setBufferPool(std::shared_ptr<BufferPool> pool)
+{
+    _impl->decompressor.setBufferPool(pool);
+    _impl->bufferPool = std::move(pool);
+}
+
+unsigned int TileDecoder::computeScale(const QSize& frameSize,
+                                       const QSize& displaySize)
+{
+    for (unsigned int scale = 8; scale > 1; scale /= 2)
+    {
+        if (int(_scaled(frameSize.width(), scale)) >= displaySize.width() &&
+            int(_scaled(frameSize.height(), scale)) >= displaySize.height())
+        {
+            return scale;
+        }
+    }
+    return 1;
 }
 
 void TileDecoder::decode(Tile& tile)
@@ -154,6 +249,48 @@ void TileDecoder::decode(Tile& tile)
     _decodeTile(&_impl->decompressor, &tile, false);
 }
 
+void TileDecoder::decode(const Tile& tile, uint8_t* buffer, int pitch)
+{
+    const auto scale = getScale();
+    const int rowSize = _scaled(tile.width, scale) * 4;
+    if (pitch == 0)
+        pitch = rowSize;
+
+    switch (tile.format)
+    {
+    case Format::jpeg:
+    {
+        auto& decompressor = _impl->decompressor;
+        const auto header = decompressor.decompressHeader(tile.imageData);
+        if (header.width != int(tile.width) ||
+            header.height != int(tile.height))
+        {
+            throw std::runtime_error("unexpected tile size");
+        }
+        decompressor.decompress(tile.imageData, buffer, pitch);
+        break;
+    }
+    case Format::rgba:
+    {
+        if (scale != 1)
+            throw std::runtime_error("Cannot scale uncompressed tiles");
+
+        const auto expectedSize =
+            _getExpectedSize(tile.format, tile.width, tile.height);
+        if (size_t(tile.imageData.size()) != expectedSize)
+            throw std::runtime_error("unexpected tile size");
+        for (unsigned int y = 0; y < tile.height; ++y)
+        {
+            std::memcpy(buffer + y * pitch,
+                        tile.imageData.constData() + y * rowSize, rowSize);
+        }
+        break;
+    }
+    default:
+        throw std::runtime_error("Tile is not in JPEG or RGBA format");
+    }
+}
+
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
 void TileDecoder::decodeToYUV(Tile& tile)
@@ -163,6 +300,81 @@ void TileDecoder::decodeToYUV(Tile& tile)
 
 #endif
 
+void TileDecoder::Impl::decode(Frame& frame, unsigned int threads,
+                               const bool skipRgbConversion)
+{
+    auto& tiles = frame.tiles;
+    if (threads == 0)
+        threads = QThread::idealThreadCount();
+    threads = std::max(1u, std::min(threads, (unsigned int)tiles.size()));
+
+    while (decompressors.size() + 1 < threads)
+        decompressors.emplace_back(new ImageJpegDecompressor);
+    for (auto& frameDecompressor : decompressors)
+    {
+        frameDecompressor->setScale(decompressor.getScale());
+        frameDecompressor->setBufferPool(bufferPool);
+    }
+    threadPool.setMaxThreadCount(threads - 1);
+
+    // Each thread takes the next tile to decode until all are done
+    std::atomic<size_t> nextTile{0};
+    std::vector<std::string> errors(tiles.size());
+    const auto decodeTiles = [&](ImageJpegDecompressor* tileDecompressor) {
+        for (auto i = nextTile++; i < tiles.size(); i = nextTile++)
+        {
+            try
+            {
+                _decodeTile(tileDecompressor, &tiles[i], skipRgbConversion);
+            }
+            catch (const std::runtime_error& e)
+            {
+                errors[i] = e.what();
+            }
+        }
+    };
+
+    std::vector<QFuture<void>> futures;
+    for (size_t i = 0; i + 1 < threads; ++i)
+    {
+        futures.emplace_back(QtConcurrent::run(&threadPool, decodeTiles,
+                                               decompressors[i].get()));
+    }
+    decodeTiles(&decompressor);
+    for (auto& future : futures)
+        future.waitForFinished();
+
+    size_t errorCount = 0;
+    std::string firstError;
+    for (const auto& error : errors)
+    {
+        if (error.empty())
+            continue;
+        if (errorCount++ == 0)
+            firstError = error;
+    }
+    if (errorCount > 0)
+    {
+        throw std::runtime_error("failed to decode " +
+                                 std::to_string(errorCount) + " tile(s): " +
+                                 firstError);
+    }
+}
+
+void TileDecoder::decode(Frame& frame, const unsigned int threads)
+{
+    _impl->decode(frame, threads, false);
+}
+
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+
+void TileDecoder::decodeToYUV(Frame& frame, const unsigned int threads)
+{
+    _impl->decode(frame, threads, true);
+}
+
+#endif
+
 void TileDecoder::startDecoding(Tile& tile)
 {
     // drop frames if we're currently processing
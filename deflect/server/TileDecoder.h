@@ -44,6 +44,8 @@
 #include <deflect/defines.h>
 #include <deflect/server/types.h>
 
+#include <QSize>
+
 namespace deflect
 {
 namespace server
@@ -60,6 +62,49 @@ public:
     /** Destruct a Decoder */
     DEFLECT_API ~TileDecoder();
 
+    /**
+     * Set the scale at which the JPEG tiles are decoded.
+     *
+     * Scaled decoding is done by libjpeg-turbo in the DCT domain, which is
+     * much faster than decoding at full size. The position and the end of the
+     * decoded tiles are divided accordingly, rounding up, so that adjacent
+     * tiles neither overlap nor leave gaps. A tile which ends in the middle of
+     * a scaled pixel (its size is not a multiple of the scale) loses its last
+     * column or row, which is drawn by the next tile. This is not supported
+     * by decodeToYUV(), which throws for such tiles. Tiles which are not in
+     * JPEG format are not scaled.
+     *
+     * @param denominator 1 (full size, default), 2, 4 or 8
+     * @throw std::invalid_argument if the scale is not supported
+     */
+    DEFLECT_API void setScale(unsigned int denominator);
+
+    /** @return the denominator of the decoding scale. */
+    DEFLECT_API unsigned int getScale() const;
+
+    /**
+     * Acquire the buffers of the tiles decoded in place from a pool.
+     *
+     * The frames dispatched by the Server give the image data of their tiles
+     * back to the pool once they are destroyed, so that decoding the tiles
+     * of a stream does not allocate memory in steady state.
+     *
+     * @param pool The pool of buffers, nullptr to allocate them (default)
+     * @see decode(Tile&)
+     */
+    DEFLECT_API void setBufferPool(std::shared_ptr<BufferPool> pool);
+
+    /**
+     * Compute the largest scale denominator for which the decoded frame is
+     * still at least as large as its display size.
+     *
+     * @param frameSize The full size of the frame
+     * @param displaySize The size at which the frame is displayed
+     * @return the denominator of the decoding scale: 1, 2, 4 or 8
+     */
+    DEFLECT_API static unsigned int computeScale(const QSize& frameSize,
+                                                 const QSize& displaySize);
+
     /**
      * Decode the data type of a JPEG tile.
      *
@@ -78,6 +123,23 @@ public:
      */
     DEFLECT_API void decode(Tile& tile);
 
+    /**
+     * Decode a tile to RGB directly into a caller-provided buffer.
+     *
+     * This avoids any intermediate buffer, for instance to decode into a
+     * mapped texture or into the tile's location in a persistent canvas.
+     * Uncompressed RGBA tiles are copied.
+     *
+     * @param tile The tile to decode, in Format::jpeg or Format::rgba.
+     * @param buffer The destination of the tile's top-left pixel, which must
+     *        hold tile.height rows of pitch bytes (divided by the scale)
+     * @param pitch The number of bytes per row of the buffer, or 0 for
+     *        tile.width * 4 (divided by the scale)
+     * @throw std::runtime_error if a decompression error occured, if the
+     *        tile is in another format or if an RGBA tile should be scaled
+     */
+    DEFLECT_API void decode(const Tile& tile, uint8_t* buffer, int pitch = 0);
+
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
     /**
@@ -90,6 +152,38 @@ public:
      */
     DEFLECT_API void decodeToYUV(Tile& tile);
 
+#endif
+
+    /**
+     * Decode all the JPEG tiles of a frame to RGB in parallel.
+     *
+     * Each thread uses its own decompressor. The function returns once all the
+     * tiles have been processed; tiles which are not in JPEG format are left
+     * untouched.
+     *
+     * @param frame The frame to decode. Upon success, all its tiles hold
+     *        decompressed RGB images in Format::rgba.
+     * @param threads The maximum number of threads to use, including the
+     *        calling thread, or 0 to use QThread::idealThreadCount()
+     * @throw std::runtime_error if any tile could not be decompressed. All
+     *        other tiles are still decoded, the failed ones keep Format::jpeg.
+     */
+    DEFLECT_API void decode(Frame& frame, unsigned int threads = 0);
+
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+
+    /**
+     * Decode all the JPEG tiles of a frame to YUV in parallel.
+     *
+     * @param frame The frame to decode. Upon success, all its tiles hold
+     *        decompressed YUV images in the matching Format::yuv4**.
+     * @param threads The maximum number of threads to use, including the
+     *        calling thread, or 0 to use QThread::idealThreadCount()
+     * @throw std::runtime_error if any tile could not be decompressed.
+     * @see decode(Frame&, unsigned int)
+     */
+    DEFLECT_API void decodeToYUV(Frame& frame, unsigned int threads = 0);
+
 #endif
 
     /**
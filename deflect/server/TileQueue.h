@@ -0,0 +1,194 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_TILEQUEUE_H
+#define DEFLECT_SERVER_TILEQUEUE_H
+
+#include <deflect/server/Frame.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wshadow"
+#endif
+#include "deflect/moodycamel/concurrentqueue.h"
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <atomic>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Lock-free queue of Tiles from a single source.
+ *
+ * The ServerWorker pushes the tiles as they are received and marks the end of
+ * each frame. The ReceiveBuffer pops them only once a frame is complete, which
+ * avoids one cross-thread signal per tile.
+ *
+ * There must be exactly one producer thread and one consumer thread.
+ *
+ * The queue also counts what the producer receives, so that the statistics of
+ * the source can be sampled from any thread without locking.
+ */
+class TileQueue
+{
+public:
+    TileQueue()
+        : _producerToken{_queue}
+        , _consumerToken{_queue}
+    {
+    }
+
+    /** Push a tile for the current frame. @note producer thread only. */
+    void push(Tile&& tile)
+    {
+        _tileCount.fetch_add(1, std::memory_order_relaxed);
+        _queue.enqueue(_producerToken,
+                       Item{std::move(tile), false, FrameTrace()});
+    }
+
+    /** Mark the end of the current frame. @note producer thread only. */
+    void pushFrameFinished(const FrameTrace& trace = FrameTrace())
+    {
+        _frameCount.fetch_add(1, std::memory_order_relaxed);
+        _queue.enqueue(_producerToken, Item{Tile(), true, trace});
+    }
+
+    /**
+     * Pop the next tile or end-of-frame marker.
+     *
+     * @param tile the next tile, if the item is not an end-of-frame marker
+     * @param frameFinished set to true if the item is an end-of-frame marker
+     * @param trace the trace of the frame, if the item is an end-of-frame
+     *        marker
+     * @return false if the queue was empty
+     * @note consumer thread only.
+     */
+    bool pop(Tile& tile, bool& frameFinished, FrameTrace& trace)
+    {
+        Item item;
+        if (!_queue.try_dequeue(_consumerToken, item))
+            return false;
+
+        tile = std::move(item.tile);
+        frameFinished = item.frameFinished;
+        trace = item.trace;
+        return true;
+    }
+
+    /** Count bytes received from the network. @note producer thread only. */
+    void addReceivedBytes(const size_t bytes)
+    {
+        _byteCount.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /** @return the number of bytes received so far. */
+    uint64_t getReceivedByteCount() const
+    {
+        return _byteCount.load(std::memory_order_relaxed);
+    }
+
+    /** @return the number of tiles pushed so far. */
+    uint64_t getPushedTileCount() const
+    {
+        return _tileCount.load(std::memory_order_relaxed);
+    }
+
+    /** @return the number of frames finished so far. */
+    uint64_t getFinishedFrameCount() const
+    {
+        return _frameCount.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Update the estimated offset of the clock of the source.
+     * @note producer thread only.
+     */
+    void setClockOffset(const int64_t offset, const int64_t roundTripTime)
+    {
+        _clockOffset.store(offset, std::memory_order_relaxed);
+        _roundTripTime.store(roundTripTime, std::memory_order_relaxed);
+        _clockSynchronized.store(true, std::memory_order_release);
+    }
+
+    /** @return true if the clock offset of the source has been estimated. */
+    bool isClockSynchronized() const
+    {
+        return _clockSynchronized.load(std::memory_order_acquire);
+    }
+
+    /** @return the client minus the server time, in microseconds. */
+    int64_t getClockOffset() const
+    {
+        return _clockOffset.load(std::memory_order_relaxed);
+    }
+
+    /** @return the round trip time of the clock offset, in microseconds. */
+    int64_t getRoundTripTime() const
+    {
+        return _roundTripTime.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Item
+    {
+        Tile tile;
+        bool frameFinished = false;
+        FrameTrace trace;
+    };
+
+    moodycamel::ConcurrentQueue<Item> _queue;
+    moodycamel::ProducerToken _producerToken;
+    moodycamel::ConsumerToken _consumerToken;
+
+    std::atomic<uint64_t> _byteCount{0};
+    std::atomic<uint64_t> _tileCount{0};
+    std::atomic<uint64_t> _frameCount{0};
+
+    std::atomic<bool> _clockSynchronized{false};
+    std::atomic<int64_t> _clockOffset{0};
+    std::atomic<int64_t> _roundTripTime{0};
+};
+}
+}
+
+#endif
@@ -46,17 +46,42 @@ namespace deflect
 {
 namespace server
 {
+class BufferPool;
 class EventReceiver;
+class FrameArchive;
+class FrameAssembler;
 class FrameDispatcher;
+class FrameRecorder;
 class TileDecoder;
+class TileQueue;
 class Server;
 
 struct Frame;
+struct FrameTrace;
+struct SourceStatistics;
+struct StreamStatistics;
 struct Tile;
 
+/** Buffering policy for the frames received by the Server for a stream. */
+enum class BufferPolicy
+{
+    all_frames,  /**< Keep all complete frames until they are dispatched. */
+    latest_frame /**< Release older frames once a newer one is complete. */
+};
+
+/** Decoding applied by the Server to the JPEG tiles as they are received. */
+enum class TileDecoding
+{
+    none, /**< Deliver the JPEG tiles to the application (default). */
+    rgba, /**< Decode the JPEG tiles to Format::rgba. */
+    yuv   /**< Decode the JPEG tiles to the matching Format::yuv4**. */
+};
+
 using Tiles = std::vector<Tile>;
 using BoolPromisePtr = std::shared_ptr<std::promise<bool>>;
 using FramePtr = std::shared_ptr<Frame>;
+using Statistics = std::vector<StreamStatistics>;
+using TileQueuePtr = std::shared_ptr<TileQueue>;
 }
 }
 
@@ -43,6 +43,7 @@
 
 #include <future>
 #include <memory>
+#include <stdexcept>
 #include <vector>
 
 namespace deflect
@@ -81,6 +82,23 @@ enum class Format : std::uint8_t
     yuv420
 };
 
+/** What a Stream does when too many frames are waiting to be sent. */
+enum class SendPolicy
+{
+    block,      /**< Wait until a queued frame has been sent. */
+    drop_oldest /**< Drop the oldest frame which is not being sent yet. */
+};
+
+/** Error of the futures of a frame dropped by SendPolicy::drop_oldest. */
+class FrameDroppedError : public std::runtime_error
+{
+public:
+    FrameDroppedError()
+        : std::runtime_error("frame dropped from the send queue")
+    {
+    }
+};
+
 /** Cast an enum class value to its underlying type. */
 template <typename E>
 constexpr typename std::underlying_type<E>::type as_underlying_type(E e)
@@ -115,6 +133,7 @@ std::future<T> make_exception_future(Exception&& e)
 
 class ImageSegmenter;
 class Stream;
+class StreamStatisticsCollector;
 
 struct Event;
 struct ImageWrapper;
@@ -122,14 +141,9 @@ struct MessageHeader;
 struct Segment;
 struct SegmentParameters;
 struct SizeHints;
+struct StreamStatistics;
 
 using Segments = std::vector<Segment>;
-
-/** @internal */
-namespace test
-{
-class Application;
-}
 }
 
 #endif
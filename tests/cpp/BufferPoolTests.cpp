@@ -0,0 +1,130 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+
+#define BOOST_TEST_MODULE BufferPoolTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/server/BufferPool.h>
+
+#include <vector>
+
+using deflect::server::BufferPool;
+
+BOOST_AUTO_TEST_CASE(releasedBufferIsReused)
+{
+    BufferPool pool;
+    auto buffer = pool.acquire(1000);
+    BOOST_CHECK_EQUAL(buffer.size(), 1000);
+    const auto data = buffer.constData();
+
+    pool.release(std::move(buffer));
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+
+    // A smaller buffer can reuse the memory of a larger one
+    const auto reused = pool.acquire(800);
+    BOOST_CHECK_EQUAL(reused.size(), 800);
+    BOOST_CHECK_EQUAL(reused.constData(), data);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.byteCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(sharedBufferIsNotKept)
+{
+    BufferPool pool;
+    auto buffer = pool.acquire(1000);
+    const auto copy = buffer;
+
+    pool.release(std::move(buffer));
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(copy.size(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(tooSmallBufferIsNotReused)
+{
+    BufferPool pool;
+    pool.release(pool.acquire(100));
+    BOOST_REQUIRE_EQUAL(pool.size(), 1);
+
+    BOOST_CHECK_EQUAL(pool.acquire(1000).size(), 1000);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(byteBudgetIsRespected)
+{
+    BufferPool pool{2500};
+    pool.release(pool.acquire(1000));
+    pool.release(pool.acquire(1000));
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+
+    auto buffers = std::vector<QByteArray>{};
+    for (int i = 0; i < 3; ++i)
+        buffers.push_back(pool.acquire(1000));
+    for (auto& buffer : buffers)
+        pool.release(std::move(buffer));
+    BOOST_CHECK_EQUAL(pool.size(), 2);
+    BOOST_CHECK_LE(pool.byteCount(), 2500);
+
+    // Larger buffers replace the smaller ones
+    pool.release(pool.acquire(2000));
+    pool.release(QByteArray(2000, 'a'));
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    BOOST_CHECK_GE(pool.byteCount(), 2000);
+    BOOST_CHECK_LE(pool.byteCount(), 2500);
+
+    // Buffers larger than the budget are never kept
+    pool.release(QByteArray(3000, 'a'));
+    BOOST_CHECK_EQUAL(pool.acquire(3000).size(), 3000);
+    BOOST_CHECK_LE(pool.byteCount(), 2500);
+}
+
+BOOST_AUTO_TEST_CASE(idleBuffersAreFreed)
+{
+    BufferPool pool{1024 * 1024, 4};
+    pool.release(QByteArray(100, 'a'));
+    BOOST_REQUIRE_EQUAL(pool.size(), 1);
+
+    // The small buffer is never reused for the larger requests
+    for (int i = 0; i < 8; ++i)
+        pool.acquire(1000);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.byteCount(), 0);
+}
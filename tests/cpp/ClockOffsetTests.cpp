@@ -0,0 +1,97 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE ClockOffsetTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/server/ClockOffset.h>
+
+using deflect::server::ClockOffset;
+
+BOOST_AUTO_TEST_CASE(offsetIsUnknownWithoutRoundTrip)
+{
+    ClockOffset clock;
+    BOOST_CHECK(!clock.isValid());
+    BOOST_CHECK_EQUAL(clock.getOffset(), 0);
+    BOOST_CHECK_EQUAL(clock.toServerTime(1234), 1234);
+}
+
+BOOST_AUTO_TEST_CASE(offsetOfSymmetricRoundTrip)
+{
+    // the client clock is 5000 µs ahead, each way takes 300 µs
+    ClockOffset clock;
+    clock.addRoundTrip(10000, 10000 + 300 + 5000, 10000 + 600);
+    BOOST_REQUIRE(clock.isValid());
+    BOOST_CHECK_EQUAL(clock.getOffset(), 5000);
+    BOOST_CHECK_EQUAL(clock.getRoundTripTime(), 600);
+    BOOST_CHECK_EQUAL(clock.toServerTime(20000), 15000);
+
+    // a client clock behind the server's gives a negative offset
+    ClockOffset late;
+    late.addRoundTrip(10000, 10000 + 300 - 5000, 10000 + 600);
+    BOOST_CHECK_EQUAL(late.getOffset(), -5000);
+}
+
+BOOST_AUTO_TEST_CASE(fastestRecentRoundTripIsUsed)
+{
+    ClockOffset clock;
+    clock.addRoundTrip(0, 5000 + 100, 200);
+    // an answer delayed by the client is less accurate
+    clock.addRoundTrip(1000, 1000 + 5000 + 2000, 1000 + 2100);
+    BOOST_CHECK_EQUAL(clock.getOffset(), 5000);
+    BOOST_CHECK_EQUAL(clock.getRoundTripTime(), 200);
+
+    // the fastest round trip is forgotten after sampleCount newer ones
+    for (size_t i = 0; i < ClockOffset::sampleCount; ++i)
+    {
+        const int64_t t = 10000 * (i + 1);
+        clock.addRoundTrip(t, t + 7000 + 200, t + 400);
+    }
+    BOOST_CHECK_EQUAL(clock.getOffset(), 7000);
+    BOOST_CHECK_EQUAL(clock.getRoundTripTime(), 400);
+}
+
+BOOST_AUTO_TEST_CASE(invalidRoundTripIsIgnored)
+{
+    ClockOffset clock;
+    clock.addRoundTrip(1000, 0, 500);
+    BOOST_CHECK(!clock.isValid());
+}
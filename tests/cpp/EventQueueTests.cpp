@@ -0,0 +1,123 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE EventQueueTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/server/EventQueue.h>
+
+using deflect::Event;
+
+namespace
+{
+Event _makeEvent(const Event::EventType type, const int key = 0,
+                 const double x = 0.0, const double dx = 0.0)
+{
+    Event event;
+    event.type = type;
+    event.key = key;
+    event.mouseX = x;
+    event.dx = dx;
+    return event;
+}
+}
+
+BOOST_AUTO_TEST_CASE(consecutiveMovesAreCoalesced)
+{
+    deflect::server::EventQueue queue;
+    queue.push(_makeEvent(Event::EVT_PRESS));
+    for (int i = 1; i <= 10; ++i)
+        queue.push(_makeEvent(Event::EVT_MOVE, 0, i * 0.1, 0.1));
+    queue.push(_makeEvent(Event::EVT_RELEASE));
+
+    const auto events = queue.takeAll();
+    BOOST_REQUIRE_EQUAL(events.size(), 3);
+    BOOST_CHECK_EQUAL(events[0].type, Event::EVT_PRESS);
+    BOOST_CHECK_EQUAL(events[1].type, Event::EVT_MOVE);
+    BOOST_CHECK_CLOSE(events[1].mouseX, 1.0, 1e-6);
+    BOOST_CHECK_CLOSE(events[1].dx, 1.0, 1e-6);
+    BOOST_CHECK_EQUAL(events[2].type, Event::EVT_RELEASE);
+    BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(movesAreNotCoalescedAcrossOtherEventsOfSamePointer)
+{
+    deflect::server::EventQueue queue;
+    queue.push(_makeEvent(Event::EVT_MOVE, 0, 0.1));
+    queue.push(_makeEvent(Event::EVT_CLICK));
+    queue.push(_makeEvent(Event::EVT_MOVE, 0, 0.2));
+
+    BOOST_CHECK_EQUAL(queue.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(touchUpdatesAreCoalescedPerTouchPoint)
+{
+    deflect::server::EventQueue queue;
+    queue.push(_makeEvent(Event::EVT_TOUCH_ADD, 1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_ADD, 2));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 1, 0.1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 2, 0.2));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 1, 0.3));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 2, 0.4));
+    queue.push(_makeEvent(Event::EVT_TOUCH_REMOVE, 1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 2, 0.5));
+
+    const auto events = queue.takeAll();
+    BOOST_REQUIRE_EQUAL(events.size(), 5);
+    BOOST_CHECK_EQUAL(events[2].type, Event::EVT_TOUCH_UPDATE);
+    BOOST_CHECK_EQUAL(events[2].key, 1);
+    BOOST_CHECK_CLOSE(events[2].mouseX, 0.3, 1e-6);
+    BOOST_CHECK_EQUAL(events[3].type, Event::EVT_TOUCH_UPDATE);
+    BOOST_CHECK_EQUAL(events[3].key, 2);
+    BOOST_CHECK_CLOSE(events[3].mouseX, 0.5, 1e-6);
+    BOOST_CHECK_EQUAL(events[4].type, Event::EVT_TOUCH_REMOVE);
+}
+
+BOOST_AUTO_TEST_CASE(touchUpdateIsNotCoalescedAcrossRemoveAndAdd)
+{
+    deflect::server::EventQueue queue;
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 1, 0.1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_REMOVE, 1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_ADD, 1));
+    queue.push(_makeEvent(Event::EVT_TOUCH_UPDATE, 1, 0.2));
+
+    BOOST_CHECK_EQUAL(queue.size(), 4);
+}
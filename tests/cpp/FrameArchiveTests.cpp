@@ -0,0 +1,168 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameArchiveTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "FrameUtils.h"
+
+#include <deflect/server/FrameArchive.h>
+#include <deflect/server/FrameRecorder.h>
+
+#include <QFile>
+
+namespace
+{
+const QString archiveFile("FrameArchiveTests.archive");
+const QString indexFile = archiveFile + ".index";
+const size_t frameCount = 5;
+
+deflect::server::Frame _makeFrame(const size_t frameIndex)
+{
+    auto frame = makeTestFrame(640, 480, 256);
+    frame.uri = "teststream";
+    for (auto& tile : frame.tiles)
+    {
+        tile.imageData = QByteArray(100 + frameIndex, char(frameIndex));
+        tile.view = deflect::View::left_eye;
+        tile.channel = frameIndex;
+    }
+    return frame;
+}
+
+void _record()
+{
+    deflect::server::FrameRecorder recorder(archiveFile);
+    for (size_t i = 0; i < frameCount; ++i)
+        recorder.record(_makeFrame(i));
+    BOOST_CHECK_EQUAL(recorder.getDroppedFrameCount(), 0);
+}
+
+void _checkFrames(const deflect::server::FrameArchive& archive,
+                  const size_t expectedCount)
+{
+    BOOST_REQUIRE_EQUAL(archive.getFrameCount(), expectedCount);
+    for (size_t i = 0; i < expectedCount; ++i)
+    {
+        const auto frame = archive.getFrame(i);
+        const auto expected = _makeFrame(i);
+        BOOST_CHECK_EQUAL(frame->uri.toStdString(), "teststream");
+        BOOST_CHECK_EQUAL(archive.getUri(i).toStdString(), "teststream");
+        compare(*frame, expected);
+        for (size_t j = 0; j < frame->tiles.size(); ++j)
+        {
+            BOOST_CHECK(frame->tiles[j].imageData ==
+                        expected.tiles[j].imageData);
+            BOOST_CHECK_EQUAL(frame->tiles[j].channel, i);
+        }
+        if (i > 0)
+            BOOST_CHECK(archive.getTimestamp(i) >= archive.getTimestamp(i - 1));
+    }
+    BOOST_CHECK_THROW(archive.getFrame(expectedCount), std::out_of_range);
+    BOOST_CHECK_THROW(archive.getUri(expectedCount), std::out_of_range);
+}
+}
+
+BOOST_AUTO_TEST_CASE(record_and_read_frames)
+{
+    _record();
+    _checkFrames(deflect::server::FrameArchive(archiveFile), frameCount);
+
+    QFile::remove(archiveFile);
+    QFile::remove(indexFile);
+}
+
+BOOST_AUTO_TEST_CASE(read_archive_without_index)
+{
+    _record();
+    QFile::remove(indexFile);
+    _checkFrames(deflect::server::FrameArchive(archiveFile), frameCount);
+
+    QFile::remove(archiveFile);
+}
+
+BOOST_AUTO_TEST_CASE(ignore_truncated_frame)
+{
+    _record();
+    {
+        QFile file(archiveFile);
+        BOOST_REQUIRE(file.resize(file.size() - 10));
+    }
+    _checkFrames(deflect::server::FrameArchive(archiveFile), frameCount - 1);
+
+    QFile::remove(archiveFile);
+    QFile::remove(indexFile);
+}
+
+BOOST_AUTO_TEST_CASE(drop_frames_when_queue_is_full)
+{
+    const size_t recordCount = 20;
+    size_t droppedCount = 0;
+    {
+        // A single frame may be waiting to be written
+        deflect::server::FrameRecorder recorder(archiveFile, 1);
+        for (size_t i = 0; i < recordCount; ++i)
+            recorder.record(_makeFrame(i));
+        droppedCount = recorder.getDroppedFrameCount();
+    }
+    {
+        const deflect::server::FrameArchive archive(archiveFile);
+        BOOST_CHECK_GE(archive.getFrameCount(), 1);
+        BOOST_CHECK_EQUAL(archive.getFrameCount() + droppedCount, recordCount);
+    }
+
+    QFile::remove(archiveFile);
+    QFile::remove(indexFile);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_archive)
+{
+    BOOST_CHECK_THROW(deflect::server::FrameArchive("nonexistent.archive"),
+                      std::runtime_error);
+    {
+        QFile file(archiveFile);
+        BOOST_REQUIRE(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(64, 'x'));
+    }
+    BOOST_CHECK_THROW(deflect::server::FrameArchive{archiveFile},
+                      std::runtime_error);
+    QFile::remove(archiveFile);
+}
@@ -0,0 +1,238 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameAssemblerTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "FrameUtils.h"
+
+#include <deflect/server/FrameAssembler.h>
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include <deflect/ImageJpegCompressor.h>
+#include <deflect/ImageWrapper.h>
+#endif
+
+#include <cstdlib> // std::abs
+
+namespace
+{
+const int width = 100;
+const int height = 60;
+const int tileSize = 32;
+
+char _pixelValue(const int x, const int y, const int component)
+{
+    return component == 3 ? char(255) : char((x + 2 * y + component) % 256);
+}
+
+// Fill the tiles of a test frame with the pixels of a top-down image
+void _fillTiles(deflect::server::Frame& frame)
+{
+    for (auto& tile : frame.tiles)
+    {
+        tile.format = deflect::Format::rgba;
+        tile.imageData.resize(tile.width * tile.height * 4);
+        auto data = tile.imageData.data();
+        for (uint32_t y = 0; y < tile.height; ++y)
+            for (uint32_t x = 0; x < tile.width; ++x)
+                for (int c = 0; c < 4; ++c)
+                    *data++ = _pixelValue(tile.x + x, tile.y + y, c);
+    }
+}
+
+// Convert a frame to bottom-up tiles as dispatched by the Server
+void _makeBottomUp(deflect::server::Frame& frame)
+{
+    for (auto& tile : frame.tiles)
+    {
+        const int rowSize = tile.width * 4;
+        QByteArray flipped(tile.imageData.size(), 0);
+        for (uint32_t y = 0; y < tile.height; ++y)
+        {
+            std::copy(tile.imageData.constData() + y * rowSize,
+                      tile.imageData.constData() + (y + 1) * rowSize,
+                      flipped.data() + (tile.height - 1 - y) * rowSize);
+        }
+        tile.imageData = flipped;
+        tile.rowOrder = deflect::RowOrder::bottom_up;
+    }
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+// Compress the tiles of a frame to JPEG as sent by the Stream
+void _compressTiles(deflect::server::Frame& frame)
+{
+    deflect::ImageJpegCompressor compressor;
+    for (auto& tile : frame.tiles)
+    {
+        deflect::ImageWrapper image(tile.imageData.constData(), tile.width,
+                                    tile.height, deflect::RGBA);
+        image.compressionQuality = 100;
+        const QRect region(0, 0, tile.width, tile.height);
+        tile.imageData = compressor.computeJpeg(image, region);
+        tile.format = deflect::Format::jpeg;
+    }
+}
+#endif
+
+// Compare an assembled image with the source image, allowing for a difference
+// of each component up to the tolerance (for lossy compression).
+void _checkImage(const deflect::server::FrameAssembler::Image& image,
+                 const bool bottomUp, const int tolerance = 0)
+{
+    BOOST_REQUIRE_EQUAL(image.size, QSize(width, height));
+    BOOST_REQUIRE_EQUAL(image.data.size(), width * height * 4);
+
+    auto data = image.data.constData();
+    for (int row = 0; row < height; ++row)
+    {
+        const int y = bottomUp ? height - 1 - row : row;
+        for (int x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const int value = uint8_t(*data++);
+                if (std::abs(value - uint8_t(_pixelValue(x, y, c))) >
+                    tolerance)
+                {
+                    BOOST_ERROR("wrong pixel at " << x << ", " << y);
+                    return;
+                }
+            }
+        }
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(assemble_rgba_frame)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+
+    deflect::server::FrameAssembler assembler;
+    const auto& images = assembler.assemble(frame);
+    BOOST_REQUIRE_EQUAL(images.size(), 1);
+    BOOST_CHECK(images[0].rowOrder == deflect::RowOrder::top_down);
+    _checkImage(images[0], false);
+
+    // The image buffer is reused for the next frame of the same size
+    const auto imageData = images[0].data.constData();
+    assembler.assemble(frame);
+    BOOST_CHECK_EQUAL(assembler.getImage().data.constData(), imageData);
+
+    BOOST_CHECK_THROW(assembler.getImage(deflect::View::left_eye),
+                      std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(assemble_bottom_up_frame)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+    _makeBottomUp(frame);
+
+    deflect::server::FrameAssembler assembler;
+    _checkImage(assembler.assemble(frame)[0], false);
+
+    assembler.setRowOrder(deflect::RowOrder::bottom_up);
+    const auto& image = assembler.assemble(frame)[0];
+    BOOST_CHECK(image.rowOrder == deflect::RowOrder::bottom_up);
+    _checkImage(image, true);
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+BOOST_AUTO_TEST_CASE(assemble_jpeg_frame)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+    _compressTiles(frame);
+
+    deflect::server::FrameAssembler assembler;
+    const auto& images = assembler.assemble(frame);
+    BOOST_REQUIRE_EQUAL(images.size(), 1);
+    BOOST_CHECK(images[0].rowOrder == deflect::RowOrder::top_down);
+    _checkImage(images[0], false, 4);
+}
+
+BOOST_AUTO_TEST_CASE(assemble_bottom_up_jpeg_frame)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+    _makeBottomUp(frame);
+    _compressTiles(frame);
+
+    deflect::server::FrameAssembler assembler;
+    _checkImage(assembler.assemble(frame)[0], false, 4);
+
+    assembler.setRowOrder(deflect::RowOrder::bottom_up);
+    const auto& image = assembler.assemble(frame)[0];
+    BOOST_CHECK(image.rowOrder == deflect::RowOrder::bottom_up);
+    _checkImage(image, true, 4);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(assemble_stereo_frame)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+    auto rightTiles = frame.tiles;
+    for (auto& tile : frame.tiles)
+        tile.view = deflect::View::left_eye;
+    for (auto& tile : rightTiles)
+        tile.view = deflect::View::right_eye;
+    frame.tiles.insert(frame.tiles.end(), rightTiles.begin(),
+                       rightTiles.end());
+
+    deflect::server::FrameAssembler assembler;
+    BOOST_CHECK_EQUAL(assembler.assemble(frame).size(), 2);
+    _checkImage(assembler.getImage(deflect::View::left_eye), false);
+    _checkImage(assembler.getImage(deflect::View::right_eye), false);
+}
+
+BOOST_AUTO_TEST_CASE(assemble_unsupported_format)
+{
+    auto frame = makeTestFrame(width, height, tileSize);
+    _fillTiles(frame);
+    frame.tiles[0].format = deflect::Format::yuv420;
+
+    deflect::server::FrameAssembler assembler;
+    BOOST_CHECK_THROW(assembler.assemble(frame), std::runtime_error);
+}
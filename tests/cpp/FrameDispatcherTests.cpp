@@ -44,7 +44,9 @@ namespace ut = boost::unit_test;
 
 #include "FrameUtils.h"
 
+#include <deflect/server/BufferPool.h>
 #include <deflect/server/FrameDispatcher.h>
+#include <deflect/server/TileQueue.h>
 
 namespace
 {
@@ -99,6 +101,144 @@ BOOST_FIXTURE_TEST_CASE(dispatch_multiple_frames, FixtureFrame)
     compare(frame, *receivedFrame);
 }
 
+BOOST_AUTO_TEST_CASE(dispatch_frames_from_tile_queue)
+{
+    deflect::server::FrameDispatcher dispatcher;
+    deflect::server::FramePtr receivedFrame;
+    QObject::connect(&dispatcher, &deflect::server::FrameDispatcher::sendFrame,
+                     [&receivedFrame](deflect::server::FramePtr frame) {
+                         receivedFrame = frame;
+                     });
+
+    auto queue = std::make_shared<deflect::server::TileQueue>();
+    dispatcher.addSource(streamId, sourceIndex, queue);
+    dispatcher.requestFrame(streamId);
+
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (auto tile : frame.tiles)
+        queue->push(std::move(tile));
+    BOOST_CHECK(!receivedFrame);
+
+    queue->pushFrameFinished();
+    dispatcher.processTileQueue(streamId, sourceIndex);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+}
+
+BOOST_AUTO_TEST_CASE(dispatched_frame_buffers_are_recycled_when_destroyed)
+{
+    auto pool = std::make_shared<deflect::server::BufferPool>();
+    deflect::server::FrameDispatcher dispatcher;
+    dispatcher.setBufferPool(pool);
+    deflect::server::FramePtr receivedFrame;
+    QObject::connect(&dispatcher, &deflect::server::FrameDispatcher::sendFrame,
+                     [&receivedFrame](deflect::server::FramePtr frame) {
+                         receivedFrame = frame;
+                     });
+
+    auto queue = std::make_shared<deflect::server::TileQueue>();
+    dispatcher.addSource(streamId, sourceIndex, queue);
+    dispatcher.requestFrame(streamId);
+
+    auto frame = makeTestFrame(640, 480, 64);
+    const auto tileCount = frame.tiles.size();
+    for (auto& tile : frame.tiles)
+        queue->push(std::move(tile)); // the received tiles own their data
+    queue->pushFrameFinished();
+    dispatcher.processTileQueue(streamId, sourceIndex);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_REQUIRE_EQUAL(receivedFrame->tiles.size(), tileCount);
+
+    // a copy of the image data still in use is not given to the pool
+    const auto copy = receivedFrame->tiles[0].imageData;
+    BOOST_CHECK_EQUAL(pool->size(), 0);
+    receivedFrame.reset();
+    BOOST_CHECK_EQUAL(pool->size(), tileCount - 1);
+    BOOST_CHECK(copy.isDetached());
+}
+
+BOOST_AUTO_TEST_CASE(dispatch_frame_trace_and_latency)
+{
+    deflect::server::FrameDispatcher dispatcher;
+    deflect::server::FramePtr receivedFrame;
+    QObject::connect(&dispatcher, &deflect::server::FrameDispatcher::sendFrame,
+                     [&receivedFrame](deflect::server::FramePtr frame) {
+                         receivedFrame = frame;
+                     });
+
+    auto queue = std::make_shared<deflect::server::TileQueue>();
+    dispatcher.addSource(streamId, sourceIndex, queue);
+    dispatcher.requestFrame(streamId);
+
+    deflect::server::FrameTrace trace;
+    trace.frameNumber = 12;
+    trace.sendTime = 1000;
+    trace.receiveTime = 3000;
+
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (auto tile : frame.tiles)
+        queue->push(std::move(tile));
+    queue->pushFrameFinished(trace);
+    dispatcher.processTileQueue(streamId, sourceIndex);
+    BOOST_REQUIRE(receivedFrame);
+
+    const auto& received = receivedFrame->trace;
+    BOOST_CHECK_EQUAL(received.frameNumber, 12);
+    BOOST_CHECK_EQUAL(received.sendTime, 1000);
+    BOOST_CHECK_EQUAL(received.receiveTime, 3000);
+    BOOST_CHECK_GT(received.dispatchTime, received.receiveTime);
+
+    const auto statistics = dispatcher.sampleStatistics();
+    BOOST_REQUIRE_EQUAL(statistics.size(), 1);
+    const auto& stats = statistics[0];
+    BOOST_CHECK_EQUAL(stats.receiveLatency.samples, 1);
+    BOOST_CHECK_EQUAL(stats.receiveLatency.min, 2000);
+    BOOST_CHECK_EQUAL(stats.dispatchLatency.samples, 1);
+    BOOST_CHECK_EQUAL(stats.totalLatency.samples, 1);
+    BOOST_CHECK_EQUAL(stats.totalLatency.max, received.dispatchTime - 1000);
+}
+
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+    deflect::server::LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.5), 0);
+
+    for (int i = 0; i < 90; ++i)
+        histogram.add(100); // bucket [64, 128[
+    for (int i = 0; i < 10; ++i)
+        histogram.add(5000); // bucket [4096, 8192[
+    histogram.add(-20); // clock offset
+
+    BOOST_CHECK_EQUAL(histogram.samples, 101);
+    BOOST_CHECK_EQUAL(histogram.min, -20);
+    BOOST_CHECK_EQUAL(histogram.max, 5000);
+    BOOST_CHECK_EQUAL(histogram.buckets[0], 1);
+    BOOST_CHECK_EQUAL(histogram.buckets[6], 90);
+    BOOST_CHECK_EQUAL(histogram.buckets[12], 10);
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.5), 128);
+    BOOST_CHECK_EQUAL(histogram.getPercentile(0.99), 5000);
+}
+
+BOOST_FIXTURE_TEST_CASE(dispatch_latest_frame_policy, FixtureFrame)
+{
+    dispatcher.setBufferPolicy(streamId,
+                               deflect::server::BufferPolicy::latest_frame);
+
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (int i = 0; i < 200; ++i)
+    {
+        for (auto& tile : frame.tiles)
+            dispatcher.processTile(streamId, sourceIndex, tile);
+        dispatcher.processFrameFinished(streamId, sourceIndex);
+    }
+    BOOST_CHECK(!receivedFrame);
+    BOOST_CHECK_EQUAL(dispatcher.getDroppedFrameCount(streamId), 199);
+
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+}
+
 BOOST_FIXTURE_TEST_CASE(dispatch_frame_bottom_up, FixtureFrame)
 {
     auto frame = makeTestFrame(640, 480, 64);
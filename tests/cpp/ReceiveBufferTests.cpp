@@ -43,6 +43,7 @@ namespace ut = boost::unit_test;
 
 #include <deflect/server/Frame.h>
 #include <deflect/server/ReceiveBuffer.h>
+#include <deflect/server/TileQueue.h>
 
 inline std::ostream& operator<<(std::ostream& str, const QSize& s)
 {
@@ -246,6 +247,37 @@ BOOST_AUTO_TEST_CASE(TestCompleteACompositeFrameMultipleSources)
     BOOST_CHECK_EQUAL(frame.computeDimensions(), QSize(192, 768));
 }
 
+BOOST_AUTO_TEST_CASE(TestPopFrameIntoReusedList)
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex1);
+    buffer.addSource(sourceIndex2);
+
+    const auto testTiles = generateTestTiles();
+
+    deflect::server::Tiles tiles;
+    for (int i = 0; i < 3; ++i)
+    {
+        buffer.insert(testTiles[0], sourceIndex1);
+        buffer.insert(testTiles[1], sourceIndex1);
+        buffer.insert(testTiles[2], sourceIndex2);
+        buffer.finishFrameForSource(sourceIndex1);
+        buffer.finishFrameForSource(sourceIndex2);
+
+        // the tiles of the previous frame are replaced
+        buffer.popFrame(tiles);
+        BOOST_REQUIRE_EQUAL(tiles.size(), 3);
+        BOOST_CHECK(!buffer.hasCompleteFrame());
+
+        deflect::server::Frame frame;
+        frame.tiles = tiles;
+        BOOST_CHECK_EQUAL(frame.computeDimensions(), QSize(192, 768));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TestRemoveSourceWhileStreaming)
 {
     const size_t sourceIndex1 = 46;
@@ -333,6 +365,253 @@ BOOST_AUTO_TEST_CASE(TestOneOfTwoSourceStopsSendingTiles)
                       std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(TestCompleteFramesFromTileQueues)
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    auto queue1 = std::make_shared<deflect::server::TileQueue>();
+    auto queue2 = std::make_shared<deflect::server::TileQueue>();
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex1, queue1);
+    buffer.addSource(sourceIndex2, queue2);
+
+    auto testTiles = generateTestTiles();
+
+    // First source pushes two frames, second source only one and a half
+    queue1->push(deflect::server::Tile(testTiles[0]));
+    queue1->push(deflect::server::Tile(testTiles[1]));
+    queue1->pushFrameFinished();
+    queue1->push(deflect::server::Tile(testTiles[0]));
+    queue1->pushFrameFinished();
+
+    queue2->push(deflect::server::Tile(testTiles[2]));
+    queue2->push(deflect::server::Tile(testTiles[3]));
+    queue2->pushFrameFinished();
+    queue2->push(deflect::server::Tile(testTiles[2]));
+
+    buffer.processTileQueue(sourceIndex1);
+    BOOST_CHECK(!buffer.hasCompleteFrame());
+
+    buffer.processTileQueue(sourceIndex2);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+
+    auto tiles = buffer.popFrame();
+    BOOST_CHECK_EQUAL(tiles.size(), 4);
+    BOOST_CHECK(!buffer.hasCompleteFrame());
+
+    // Second frame is completed by the last tile of the second source
+    queue2->push(deflect::server::Tile(testTiles[3]));
+    queue2->pushFrameFinished();
+    buffer.processTileQueue(sourceIndex2);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+
+    tiles = buffer.popFrame();
+    BOOST_CHECK_EQUAL(tiles.size(), 3);
+    BOOST_CHECK(!buffer.hasCompleteFrame());
+
+    // Sources without a queue are not affected
+    BOOST_CHECK_NO_THROW(buffer.processTileQueue(7777));
+}
+
+BOOST_AUTO_TEST_CASE(TestLatestFramePolicyDropsOlderFrames)
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex1);
+    buffer.addSource(sourceIndex2);
+    buffer.setBufferPolicy(deflect::server::BufferPolicy::latest_frame);
+
+    const auto testTiles = generateTestTiles();
+
+    // Complete 3 frames, only the last one is kept
+    for (int i = 0; i < 3; ++i)
+    {
+        buffer.insert(testTiles[0], sourceIndex1);
+        buffer.finishFrameForSource(sourceIndex1);
+        buffer.insert(testTiles[1], sourceIndex2);
+        buffer.insert(testTiles[2], sourceIndex2);
+        buffer.finishFrameForSource(sourceIndex2);
+    }
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 2);
+
+    // A frame finished by only one source is not complete, so it does not
+    // cause the previous frame to be dropped
+    buffer.insert(testTiles[3], sourceIndex1);
+    buffer.finishFrameForSource(sourceIndex1);
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 2);
+
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    const auto tiles = buffer.popFrame();
+    BOOST_CHECK_EQUAL(tiles.size(), 3);
+    BOOST_CHECK(!buffer.hasCompleteFrame());
+}
+
+BOOST_AUTO_TEST_CASE(TestPopLatestFrame)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    const auto testTiles = generateTestTiles();
+    for (size_t i = 0; i < testTiles.size(); ++i)
+    {
+        buffer.insert(testTiles[i], sourceIndex);
+        buffer.finishFrameForSource(sourceIndex);
+    }
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 0);
+
+    const auto tiles = buffer.popLatestFrame();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 1);
+    BOOST_CHECK_EQUAL(tiles[0].x, testTiles[3].x);
+    BOOST_CHECK_EQUAL(tiles[0].y, testTiles[3].y);
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 3);
+    BOOST_CHECK(!buffer.hasCompleteFrame());
+}
+
+BOOST_AUTO_TEST_CASE(TestStatistics)
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    auto queue1 = std::make_shared<deflect::server::TileQueue>();
+    auto queue2 = std::make_shared<deflect::server::TileQueue>();
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex1, queue1);
+    buffer.addSource(sourceIndex2, queue2);
+
+    const auto testTiles = generateTestTiles();
+
+    // First source finishes three frames, second source only two
+    for (int i = 0; i < 3; ++i)
+    {
+        queue1->addReceivedBytes(100);
+        queue1->push(deflect::server::Tile(testTiles[0]));
+        queue1->pushFrameFinished();
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        queue2->addReceivedBytes(50);
+        queue2->push(deflect::server::Tile(testTiles[1]));
+        queue2->push(deflect::server::Tile(testTiles[2]));
+        queue2->pushFrameFinished();
+    }
+    buffer.processTileQueue(sourceIndex1);
+    buffer.processTileQueue(sourceIndex2);
+    buffer.popLatestFrame();
+
+    const auto stats = buffer.getStatistics();
+    BOOST_CHECK_EQUAL(stats.receivedBytes, 400);
+    BOOST_CHECK_EQUAL(stats.receivedTiles, 7);
+    BOOST_CHECK_EQUAL(stats.completeFrames, 2);
+    BOOST_CHECK_EQUAL(stats.dispatchedFrames, 1);
+    BOOST_CHECK_EQUAL(stats.droppedFrames, 1);
+    BOOST_CHECK_EQUAL(stats.queuedFrames, 0);
+    BOOST_CHECK_EQUAL(stats.bufferedBytes, buffer.getByteCount());
+
+    BOOST_REQUIRE_EQUAL(stats.sources.size(), 2);
+    const auto& source1 = stats.sources[0];
+    BOOST_CHECK_EQUAL(source1.sourceIndex, sourceIndex1);
+    BOOST_CHECK_EQUAL(source1.receivedBytes, 300);
+    BOOST_CHECK_EQUAL(source1.receivedTiles, 3);
+    BOOST_CHECK_EQUAL(source1.receivedFrames, 3);
+    BOOST_CHECK_EQUAL(source1.queuedFrames, 1);
+    BOOST_CHECK_EQUAL(source1.bufferedBytes,
+                      size_t(testTiles[0].imageData.size()));
+
+    const auto& source2 = stats.sources[1];
+    BOOST_CHECK_EQUAL(source2.sourceIndex, sourceIndex2);
+    BOOST_CHECK_EQUAL(source2.receivedFrames, 2);
+    BOOST_CHECK_EQUAL(source2.queuedFrames, 0);
+    BOOST_CHECK_EQUAL(source2.bufferedBytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestFrameTraceOfMultipleSources)
+{
+    const size_t sourceIndex1 = 46;
+    const size_t sourceIndex2 = 819;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex1);
+    buffer.addSource(sourceIndex2);
+
+    const auto testTiles = generateTestTiles();
+
+    deflect::server::FrameTrace trace1;
+    trace1.frameNumber = 7;
+    trace1.sendTime = 2000;
+    trace1.receiveTime = 5000;
+
+    deflect::server::FrameTrace trace2;
+    trace2.frameNumber = 8;
+    trace2.sendTime = 1500;
+    trace2.receiveTime = 6000;
+
+    buffer.insert(testTiles[0], sourceIndex1);
+    buffer.finishFrameForSource(sourceIndex1, trace1);
+    buffer.insert(testTiles[1], sourceIndex2);
+    buffer.finishFrameForSource(sourceIndex2, trace2);
+
+    // Sources which did not send a trace are ignored
+    buffer.insert(testTiles[2], sourceIndex1);
+    buffer.finishFrameForSource(sourceIndex1);
+    buffer.insert(testTiles[3], sourceIndex2);
+    buffer.finishFrameForSource(sourceIndex2, trace2);
+
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    auto trace = buffer.getFrameTrace();
+    BOOST_CHECK_EQUAL(trace.frameNumber, 7);
+    BOOST_CHECK_EQUAL(trace.sendTime, 1500);
+    BOOST_CHECK_EQUAL(trace.receiveTime, 6000);
+    buffer.popFrame();
+
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    trace = buffer.getFrameTrace();
+    BOOST_CHECK_EQUAL(trace.frameNumber, 8);
+    BOOST_CHECK_EQUAL(trace.sendTime, 1500);
+    BOOST_CHECK_EQUAL(trace.receiveTime, 6000);
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryBudget)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+    BOOST_CHECK_EQUAL(buffer.getMemoryBudget(), 0);
+
+    deflect::server::Tile tile;
+    tile.width = 64;
+    tile.height = 64;
+    tile.imageData = QByteArray(1000, 'x');
+
+    buffer.setMemoryBudget(2500);
+    buffer.insert(tile, sourceIndex);
+    buffer.finishFrameForSource(sourceIndex);
+    buffer.insert(tile, sourceIndex);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK_EQUAL(buffer.getByteCount(), 2000);
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 0);
+
+    // Exceeding the budget releases the older complete frames
+    buffer.insert(tile, sourceIndex);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK_EQUAL(buffer.getByteCount(), 1000);
+    BOOST_CHECK_EQUAL(buffer.getDroppedFrameCount(), 2);
+
+    // A single frame which does not fit is an error
+    buffer.insert(tile, sourceIndex);
+    buffer.insert(tile, sourceIndex);
+    buffer.insert(tile, sourceIndex);
+    BOOST_CHECK_THROW(buffer.finishFrameForSource(sourceIndex),
+                      std::runtime_error);
+}
+
 void _insert(deflect::server::ReceiveBuffer& buffer, const size_t sourceIndex,
              const deflect::server::Tiles& frame)
 {
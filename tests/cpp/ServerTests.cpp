@@ -46,11 +46,17 @@ namespace ut = boost::unit_test;
 #include "MinimalGlobalQtApp.h"
 #include "boost_test_thread_safe.h"
 
+#include <deflect/Segment.h>
 #include <deflect/Stream.h>
+#include <deflect/defines.h>
 #include <deflect/server/Frame.h>
 
+#include <algorithm>
 #include <boost/mpl/vector.hpp>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace
 {
@@ -143,6 +149,44 @@ BOOST_AUTO_TEST_CASE(dataReceivedByServer)
     SAFE_BOOST_CHECK(received);
 }
 
+BOOST_AUTO_TEST_CASE(dataSentWhileImageIsTransmitted)
+{
+    const auto sentData = std::string{"Hello World!"};
+
+    bool received = false;
+    setDataReceivedCallback([&](const QString, QByteArray data) {
+        SAFE_BOOST_CHECK_EQUAL(std::string(data.constData()), sentData);
+        // the frame is dispatched only once its finish is received
+        SAFE_BOOST_CHECK_EQUAL(getReceivedFrames(), 0);
+        received = true;
+    });
+
+    const unsigned int width = 2048;
+    const unsigned int height = 2048;
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = uint8_t(i * 7);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    // dispatch the frame as soon as it is finished
+    requestFrame(testStreamId);
+
+    // the data is sent between the segments of the image, before its finish
+    auto frameSent = stream.sendAndFinish(image);
+    BOOST_CHECK(stream.sendData(sentData.data(), sentData.size()));
+    BOOST_CHECK(frameSent.get());
+
+    while (!received || getReceivedFrames() == 0)
+        waitForMessage();
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
 BOOST_AUTO_TEST_CASE(oneObserverAndOneStream)
 {
     setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
@@ -207,6 +251,55 @@ BOOST_AUTO_TEST_CASE(oneObserverAndOneStream)
     SAFE_BOOST_CHECK_EQUAL(getReceivedFrames(), expectedFrames);
 }
 
+BOOST_AUTO_TEST_CASE(eventsPushedToObserverCallback)
+{
+    std::mutex mutex;
+    std::condition_variable received;
+    std::vector<deflect::Event> events;
+    const size_t expectedEvents = 3;
+
+    {
+        deflect::Observer observer(testStreamId.toStdString(), "localhost",
+                                   serverPort());
+        SAFE_BOOST_REQUIRE(observer.isConnected());
+        waitForMessage(); // handle observer open
+
+        SAFE_BOOST_CHECK(observer.registerForEvents(true));
+        waitForMessage();
+
+        observer.setEventCallback([&](const deflect::Event event) {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back(event);
+            received.notify_one();
+        });
+
+        deflect::Event event;
+        event.type = deflect::Event::EVT_CLICK;
+        for (size_t i = 0; i < expectedEvents; ++i)
+        {
+            event.key = i;
+            processEvent(event);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            SAFE_BOOST_REQUIRE(
+                received.wait_for(lock, std::chrono::seconds(5),
+                                  [&] { return events.size() > i; }));
+        }
+        observer.setEventCallback(nullptr);
+    }
+
+    SAFE_BOOST_REQUIRE_EQUAL(events.size(), expectedEvents);
+    for (size_t i = 0; i < expectedEvents; ++i)
+    {
+        SAFE_BOOST_CHECK_EQUAL(events[i].type, deflect::Event::EVT_CLICK);
+        SAFE_BOOST_CHECK_EQUAL(events[i].key, int(i));
+    }
+
+    // handle close of observer
+    waitForMessage();
+    SAFE_BOOST_CHECK_EQUAL(getOpenedStreams(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(closeObserverBeforeStream)
 {
     {
@@ -448,4 +541,672 @@ BOOST_AUTO_TEST_CASE(uncompressedImages)
     BOOST_CHECK_EQUAL(getReceivedFrames(), expectedFrames);
 }
 
+BOOST_AUTO_TEST_CASE(framesQueuedDuringAsyncConnection)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    std::promise<bool> connected;
+    auto stream = deflect::Stream::connectAsync(
+        testStreamId.toStdString(), "localhost", serverPort(),
+        [&](const bool success) { connected.set_value(success); });
+
+    // sent before the connection is established
+    auto frameSent = stream->sendAndFinish(image);
+
+    BOOST_CHECK(connected.get_future().get());
+    BOOST_CHECK(stream->isConnected());
+    BOOST_CHECK(frameSent.get());
+    waitForMessage(); // handle stream open
+
+    requestFrame(testStreamId);
+    waitForMessage();
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(eventCallbackSetDuringAsyncConnection)
+{
+    std::mutex mutex;
+    std::condition_variable received;
+    std::vector<deflect::Event> events;
+
+    std::promise<bool> connected;
+    auto stream = deflect::Stream::connectAsync(
+        testStreamId.toStdString(), "localhost", serverPort(),
+        [&](const bool success) { connected.set_value(success); });
+
+    // set before the connection is established
+    stream->setEventCallback([&](const deflect::Event event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+        received.notify_one();
+    });
+
+    BOOST_REQUIRE(connected.get_future().get());
+    waitForMessage(); // handle stream open
+    BOOST_CHECK(stream->registerForEvents(true));
+    waitForMessage();
+
+    deflect::Event event;
+    event.type = deflect::Event::EVT_CLICK;
+    processEvent(event);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        BOOST_REQUIRE(received.wait_for(lock, std::chrono::seconds(5),
+                                        [&] { return !events.empty(); }));
+        BOOST_REQUIRE_EQUAL(events.size(), 1);
+        BOOST_CHECK_EQUAL(events[0].type, deflect::Event::EVT_CLICK);
+    }
+    stream->setEventCallback(nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(asyncConnectionFailure)
+{
+    bool connected = true;
+    auto stream = deflect::Stream::connectAsync(
+        testStreamId.toStdString(), "deflect.invalid", serverPort(),
+        [&](const bool success) { connected = success; });
+    BOOST_CHECK(!stream->finishFrame().get());
+    BOOST_CHECK(!connected);
+    BOOST_CHECK(!stream->isConnected());
+}
+
+BOOST_AUTO_TEST_CASE(streamsMultiplexedOverOneConnection)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    std::vector<QString> frameUris;
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_CHECK_EQUAL(frame->tiles.size(), 1);
+        frameUris.push_back(frame->uri);
+    });
+
+    const QString otherStreamId = testStreamId + "_2";
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+    {
+        deflect::Stream other(otherStreamId.toStdString(), stream);
+        BOOST_REQUIRE(other.isConnected());
+        waitForMessage(); // handle other stream open
+        BOOST_CHECK_EQUAL(getOpenedStreams(), 2);
+
+        BOOST_CHECK_THROW(deflect::Stream(otherStreamId.toStdString(), stream),
+                          std::runtime_error);
+        BOOST_CHECK(!other.registerForEvents());
+
+        BOOST_CHECK(stream.sendAndFinish(image).get());
+        requestFrame(testStreamId);
+        waitForMessage();
+
+        BOOST_CHECK(other.sendAndFinish(image).get());
+        requestFrame(otherStreamId);
+        waitForMessage();
+    }
+    waitForMessage(); // handle other stream close
+
+    BOOST_CHECK_EQUAL(getOpenedStreams(), 1);
+    BOOST_CHECK(stream.isConnected());
+    BOOST_REQUIRE_EQUAL(frameUris.size(), 2);
+    BOOST_CHECK_EQUAL(frameUris[0].toStdString(), testStreamId.toStdString());
+    BOOST_CHECK_EQUAL(frameUris[1].toStdString(), otherStreamId.toStdString());
+}
+
+BOOST_AUTO_TEST_CASE(multiplexedStreamClosedByServer)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    const QString otherStreamId = testStreamId + "_2";
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    deflect::Stream other(otherStreamId.toStdString(), stream);
+    BOOST_REQUIRE(other.isConnected());
+    waitForMessage(); // handle other stream open
+
+    std::promise<void> otherDisconnected;
+    other.setDisconnectedCallback([&] { otherDisconnected.set_value(); });
+
+    closePixelStream(otherStreamId);
+    waitForMessage(); // handle other stream close
+    BOOST_CHECK_EQUAL(getOpenedStreams(), 1);
+
+    // The client reads the close notification while it is sending
+    auto disconnected = otherDisconnected.get_future();
+    for (int i = 0; i < 100; ++i)
+    {
+        other.sendAndFinish(image).wait();
+        if (disconnected.wait_for(std::chrono::milliseconds(10)) ==
+            std::future_status::ready)
+        {
+            break;
+        }
+    }
+    BOOST_REQUIRE(disconnected.wait_for(std::chrono::seconds(0)) ==
+                  std::future_status::ready);
+    BOOST_CHECK(!other.isConnected());
+    BOOST_CHECK(!other.sendAndFinish(image).get());
+
+    BOOST_CHECK(stream.isConnected());
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    requestFrame(testStreamId);
+    waitForMessage();
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(oldestFramesDroppedWhenSendQueueIsFull)
+{
+    const unsigned int width = 1024;
+    const unsigned int height = 1024;
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = uint8_t(i * 7);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    stream.setSendPolicy(deflect::SendPolicy::drop_oldest, 1);
+
+    std::vector<deflect::Stream::Future> futures;
+    for (size_t i = 0; i < 5; ++i)
+        futures.emplace_back(stream.sendAndFinish(image));
+
+    size_t sentFrames = 0;
+    size_t droppedFrames = 0;
+    for (auto& future : futures)
+    {
+        try
+        {
+            BOOST_CHECK(future.get());
+            ++sentFrames;
+        }
+        catch (const deflect::FrameDroppedError&)
+        {
+            ++droppedFrames;
+        }
+    }
+
+    // the latest frame is never dropped
+    BOOST_CHECK(futures.size() > droppedFrames);
+    BOOST_CHECK_EQUAL(droppedFrames, stream.getStatistics().droppedFrames);
+    BOOST_CHECK_EQUAL(sentFrames + droppedFrames, futures.size());
+}
+
+BOOST_AUTO_TEST_CASE(failedFramesAreNotReportedAsDropped)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    stream.setSendPolicy(deflect::SendPolicy::drop_oldest, 1);
+
+    std::promise<void> streamDisconnected;
+    stream.setDisconnectedCallback([&] { streamDisconnected.set_value(); });
+
+    closePixelStream(testStreamId);
+    waitForMessage(); // handle stream close
+
+    // The client notices the disconnection while it is sending
+    auto disconnected = streamDisconnected.get_future();
+    for (int i = 0; i < 100; ++i)
+    {
+        stream.sendAndFinish(image).wait();
+        if (disconnected.wait_for(std::chrono::milliseconds(10)) ==
+            std::future_status::ready)
+        {
+            break;
+        }
+    }
+    BOOST_REQUIRE(disconnected.wait_for(std::chrono::seconds(0)) ==
+                  std::future_status::ready);
+
+    // the frame fails without being dropped, the queue is not full
+    BOOST_CHECK(!stream.sendAndFinish(image).get());
+    BOOST_CHECK_EQUAL(stream.getStatistics().droppedFrames, 0);
+}
+
+BOOST_AUTO_TEST_CASE(frameCreditsGrantedWhenFramesAreDispatched)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    BOOST_CHECK(stream.canSendFrame());
+    BOOST_REQUIRE(stream.enableFrameCredits());
+
+    // initial credit
+    while (!stream.canSendFrame())
+        ;
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    BOOST_CHECK(!stream.canSendFrame());
+
+    // the credit is granted once the application gets the frame
+    requestFrame(testStreamId);
+    waitForMessage();
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+    while (!stream.canSendFrame())
+        ;
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    BOOST_CHECK(!stream.canSendFrame());
+}
+
+BOOST_AUTO_TEST_CASE(imagesSentConcurrentlyByThreads)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    const size_t threadCount = 4;
+
+    uint64_t expectedFrameNumber = 1;
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_CHECK_EQUAL(frame->trace.frameNumber, expectedFrameNumber);
+        SAFE_BOOST_CHECK_EQUAL(frame->tiles.size(), threadCount);
+        ++expectedFrameNumber;
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    // each thread sends its own part of frames 1 and 2
+    std::vector<deflect::Stream::Future> sends(threadCount * 2);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([&, i] {
+            deflect::ImageWrapper image(pixels.data(), width, height,
+                                        deflect::RGBA, i * width);
+            image.compressionPolicy = deflect::COMPRESSION_OFF;
+            sends[i * 2] = stream.send(image, 1);
+            sends[i * 2 + 1] = stream.send(image, 2);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    // frame 3 would never be finished
+    BOOST_CHECK_THROW(stream.finishFrame(4).get(), std::runtime_error);
+
+    BOOST_CHECK(stream.finishFrame(1).get());
+    requestFrame(testStreamId);
+    waitForMessage();
+    BOOST_CHECK(stream.finishFrame(2).get());
+    requestFrame(testStreamId);
+    waitForMessage();
+    for (auto& send : sends)
+        BOOST_CHECK(send.get());
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 2);
+
+    BOOST_CHECK_THROW(stream.finishFrame(1).get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(stereoImagesSentTogether)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+
+    std::vector<deflect::ImageWrapper> images;
+    for (auto view : {deflect::View::left_eye, deflect::View::right_eye})
+    {
+        images.emplace_back(pixels.data(), width, height, deflect::RGBA);
+        images.back().compressionPolicy = deflect::COMPRESSION_OFF;
+        images.back().view = view;
+    }
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 2);
+        SAFE_BOOST_CHECK(frame->tiles[0].view == deflect::View::left_eye);
+        SAFE_BOOST_CHECK(frame->tiles[1].view == deflect::View::right_eye);
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    BOOST_CHECK_THROW(stream.send(std::vector<deflect::ImageWrapper>()).get(),
+                      std::invalid_argument);
+    BOOST_CHECK(stream.send(images).get());
+    BOOST_CHECK(stream.finishFrame().get());
+    requestFrame(testStreamId);
+    waitForMessage();
+
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(segmentsSentAsIs)
+{
+    deflect::Segment segment;
+    segment.parameters.x = 8;
+    segment.parameters.y = 4;
+    segment.parameters.width = 2;
+    segment.parameters.height = 2;
+    segment.parameters.format = deflect::Format::rgba;
+    segment.imageData = QByteArray(2 * 2 * 4, 17);
+    segment.view = deflect::View::left_eye;
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+        const auto& tile = frame->tiles[0];
+        SAFE_BOOST_CHECK_EQUAL(tile.x, 8u);
+        SAFE_BOOST_CHECK_EQUAL(tile.y, 4u);
+        SAFE_BOOST_CHECK(tile.view == deflect::View::left_eye);
+        SAFE_BOOST_CHECK(tile.imageData == segment.imageData);
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    BOOST_CHECK(stream.sendSegment(segment).get());
+    BOOST_CHECK(stream.finishFrame().get());
+    requestFrame(testStreamId);
+    waitForMessage();
+
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(invalidSegmentsRejected)
+{
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    deflect::Segment segment;
+    segment.parameters.width = 2;
+    segment.parameters.height = 2;
+    segment.parameters.format = deflect::Format::rgba;
+    segment.imageData = QByteArray(2 * 2 * 4 - 1, 17);
+    BOOST_CHECK_THROW(stream.sendSegment(segment).get(),
+                      std::invalid_argument);
+
+    segment.imageData = QByteArray(2 * 2 * 4, 17);
+    segment.parameters.width = 0;
+    BOOST_CHECK_THROW(stream.sendSegment(segment).get(),
+                      std::invalid_argument);
+
+    segment.parameters.width = 2;
+    segment.parameters.format = deflect::Format::jpeg;
+    BOOST_CHECK_THROW(stream.sendSegment(segment).get(),
+                      std::invalid_argument);
+
+    segment.parameters.format = deflect::Format::yuv420;
+    BOOST_CHECK_THROW(stream.sendSegment(segment).get(),
+                      std::invalid_argument);
+
+    segment.parameters.format = deflect::Format::rgba;
+    BOOST_CHECK(stream.sendSegment(segment).get());
+    BOOST_CHECK(stream.finishFrame().get());
+}
+
+BOOST_AUTO_TEST_CASE(statisticsOfStream)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    requestFrame(testStreamId);
+    waitForMessage();
+    BOOST_REQUIRE_EQUAL(getReceivedFrames(), 1);
+
+    const auto statistics = getStatistics();
+    BOOST_REQUIRE_EQUAL(statistics.size(), 1);
+    const auto& stats = statistics[0];
+    BOOST_CHECK(stats.uri == testStreamId);
+    BOOST_CHECK_EQUAL(stats.receivedTiles, 1);
+    BOOST_CHECK_GT(stats.receivedBytes, pixels.size());
+    BOOST_CHECK_EQUAL(stats.completeFrames, 1);
+    BOOST_CHECK_EQUAL(stats.dispatchedFrames, 1);
+    BOOST_CHECK_EQUAL(stats.droppedFrames, 0);
+    BOOST_CHECK_EQUAL(stats.queuedFrames, 0);
+    BOOST_CHECK_GT(stats.bytesPerSecond, 0.0);
+    BOOST_REQUIRE_EQUAL(stats.sources.size(), 1);
+    BOOST_CHECK_EQUAL(stats.sources[0].receivedFrames, 1);
+
+    // Rates are computed since the previous sample
+    BOOST_CHECK_EQUAL(getStatistics()[0].bytesPerSecond, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(frameTraceReceivedByServer)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    const size_t frameCount = 3;
+    uint64_t expectedFrameNumber = 1;
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        const auto& trace = frame->trace;
+        SAFE_BOOST_CHECK_EQUAL(trace.frameNumber, expectedFrameNumber);
+        SAFE_BOOST_CHECK(trace.sendTime > 0);
+        SAFE_BOOST_CHECK(trace.receiveTime >= trace.sendTime);
+        SAFE_BOOST_CHECK(trace.dispatchTime >= trace.receiveTime);
+        ++expectedFrameNumber;
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        stream.sendAndFinish(image).wait();
+        requestFrame(testStreamId);
+        waitForMessage();
+    }
+    BOOST_CHECK_EQUAL(getReceivedFrames(), frameCount);
+
+    const auto stats = getStatistics();
+    BOOST_REQUIRE_EQUAL(stats.size(), 1);
+    BOOST_CHECK_EQUAL(stats[0].totalLatency.samples, frameCount);
+    BOOST_CHECK_EQUAL(stats[0].receiveLatency.samples, frameCount);
+    BOOST_CHECK_EQUAL(stats[0].dispatchLatency.samples, frameCount);
+}
+
+BOOST_AUTO_TEST_CASE(clockOffsetEstimatedByServer)
+{
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    // The client answers the pings of the server when it reads the socket
+    deflect::server::SourceStatistics source;
+    for (int i = 0; i < 100 && !source.clockSynchronized; ++i)
+    {
+        stream.sendAndFinish(image).wait();
+        requestFrame(testStreamId);
+        waitForMessage();
+
+        const auto stats = getStatistics();
+        BOOST_REQUIRE_EQUAL(stats.size(), 1);
+        BOOST_REQUIRE_EQUAL(stats[0].sources.size(), 1);
+        source = stats[0].sources[0];
+    }
+    BOOST_REQUIRE(source.clockSynchronized);
+
+    // Both ends use the same clock, the error is at most half a round trip
+    BOOST_CHECK_GE(source.roundTripTime, 0);
+    BOOST_CHECK_LE(std::abs(source.clockOffset), source.roundTripTime / 2 + 1);
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+BOOST_AUTO_TEST_CASE(tilesDecodedByServer)
+{
+    const unsigned int width = 256;
+    const unsigned int height = 128;
+    const std::vector<uint8_t> pixels(width * height * 4, 42);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+
+    setTileDecoding(deflect::server::TileDecoding::rgba);
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE(!frame->tiles.empty());
+        for (const auto& tile : frame->tiles)
+        {
+            SAFE_BOOST_CHECK(tile.format == deflect::Format::rgba);
+            SAFE_BOOST_CHECK_EQUAL(size_t(tile.imageData.size()),
+                                   size_t(tile.width * tile.height * 4));
+        }
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), width);
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), height);
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    requestFrame(testStreamId);
+    waitForMessage();
+
+    BOOST_CHECK_EQUAL(getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(jpegImagesCompressedByThreads)
+{
+    // Each image is compressed in its thread as 2x2 segments
+    const unsigned int width = 1024;
+    const unsigned int height = 1024;
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = uint8_t(i * 7);
+    const size_t threadCount = 4;
+    const size_t frameCount = 2;
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_CHECK_EQUAL(frame->tiles.size(), threadCount * 4);
+        for (const auto& tile : frame->tiles)
+            SAFE_BOOST_CHECK(tile.format == deflect::Format::jpeg);
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), threadCount * width);
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), height);
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    std::vector<deflect::Stream::Future> sends(threadCount * frameCount);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([&, i] {
+            deflect::ImageWrapper image(pixels.data(), width, height,
+                                        deflect::RGBA, i * width);
+            image.compressionPolicy = deflect::COMPRESSION_ON;
+            for (size_t frame = 0; frame < frameCount; ++frame)
+                sends[i * frameCount + frame] = stream.send(image, frame + 1);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t frame = 0; frame < frameCount; ++frame)
+    {
+        BOOST_CHECK(stream.finishFrame(frame + 1).get());
+        requestFrame(testStreamId);
+        waitForMessage();
+    }
+    for (auto& send : sends)
+        BOOST_CHECK(send.get());
+    BOOST_CHECK_EQUAL(getReceivedFrames(), frameCount);
+}
+
+BOOST_AUTO_TEST_CASE(statisticsOfClientStream)
+{
+    const unsigned int width = 1024;
+    const unsigned int height = 1024;
+    const std::vector<uint8_t> pixels(width * height * 4, 128);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+
+    const size_t frameCount = 3;
+
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        BOOST_CHECK(stream.sendAndFinish(image).get());
+        requestFrame(testStreamId);
+        waitForMessage();
+    }
+
+    const auto stats = stream.getStatistics();
+    BOOST_CHECK_EQUAL(stats.frames, frameCount);
+    BOOST_CHECK_EQUAL(stats.encodeTime.samples, frameCount);
+    BOOST_CHECK_GT(stats.encodeTime.max, 0.0);
+    BOOST_CHECK_GE(stats.compressionThreads.min, 1.0);
+    BOOST_CHECK_EQUAL(stats.rawBytes, frameCount * pixels.size());
+    BOOST_CHECK_GT(stats.compressedBytes, 0);
+    BOOST_CHECK_GT(stats.compressionRatio, 1.0);
+    // the stream opening is also a request with a future
+    BOOST_CHECK_EQUAL(stats.sendLatency.samples, frameCount + 1);
+    BOOST_CHECK_EQUAL(stats.socketTime.samples, frameCount);
+    BOOST_CHECK_EQUAL(stats.queuedRequests.samples, frameCount);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -45,11 +45,14 @@ namespace ut = boost::unit_test;
 #include <deflect/ImageJpegCompressor.h>
 #include <deflect/ImageSegmenter.h>
 #include <deflect/ImageWrapper.h>
+#include <deflect/server/BufferPool.h>
+#include <deflect/server/Frame.h>
 #include <deflect/server/ImageJpegDecompressor.h>
 #include <deflect/server/Tile.h>
 #include <deflect/server/TileDecoder.h>
 
 #include <QMutex>
+#include <algorithm>
 #include <cmath> // std::round
 
 namespace
@@ -282,6 +285,180 @@ BOOST_AUTO_TEST_CASE(testImageSegmentationWithCompressionAndDecompression)
                                   dataOut + tile.imageData.size());
 }
 
+BOOST_AUTO_TEST_CASE(testDecompressionIntoCallerBuffer)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    deflect::server::Tile tile;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    // Decode into the right half of a 16x8 canvas
+    const int pitch = 16 * 4;
+    std::vector<char> canvas(8 * pitch, 0);
+    deflect::server::TileDecoder decoder;
+    decoder.decode(tile, (uint8_t*)canvas.data() + 8 * 4, pitch);
+
+    for (int y = 0; y < 8; ++y)
+    {
+        const auto row = canvas.data() + y * pitch;
+        const auto expected = data.data() + y * 8 * 4;
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected, expected + 8 * 4, row + 8 * 4,
+                                      row + 16 * 4);
+        BOOST_CHECK(std::all_of(row, row + 8 * 4, [](char c) { return !c; }));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testDecodedTilesReuseBuffersOfPool)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    auto pool = std::make_shared<deflect::server::BufferPool>();
+    deflect::server::TileDecoder decoder;
+    decoder.setBufferPool(pool);
+
+    deflect::server::Frame frame;
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        deflect::server::Tile tile;
+        tile.x = i * 8;
+        tile.width = 8;
+        tile.height = 8;
+        tile.imageData = jpegData;
+        frame.tiles.push_back(tile);
+    }
+
+    // Decoding a frame whose buffers were given back does not allocate
+    for (int i = 0; i < 3; ++i)
+    {
+        for (auto& tile : frame.tiles)
+        {
+            tile.format = deflect::Format::jpeg;
+            pool->release(std::move(tile.imageData));
+            tile.imageData = jpegData;
+        }
+        BOOST_CHECK_EQUAL(pool->size(), i == 0 ? 0 : frame.tiles.size());
+
+        decoder.decode(frame, 2);
+        BOOST_CHECK_EQUAL(pool->size(), 0);
+
+        for (const auto& tile : frame.tiles)
+        {
+            BOOST_REQUIRE_EQUAL(tile.format, deflect::Format::rgba);
+            const char* dataOut = tile.imageData.constData();
+            BOOST_CHECK_EQUAL_COLLECTIONS(data.data(),
+                                          data.data() + data.size(), dataOut,
+                                          dataOut + data.size());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testScaledDecompression)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    deflect::server::Tile tile;
+    tile.x = 16;
+    tile.y = 8;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    deflect::server::TileDecoder decoder;
+    BOOST_CHECK_THROW(decoder.setScale(3), std::invalid_argument);
+    decoder.setScale(2);
+    BOOST_CHECK_EQUAL(decoder.getScale(), 2);
+    decoder.decode(tile);
+
+    BOOST_CHECK_EQUAL(tile.format, deflect::Format::rgba);
+    BOOST_CHECK_EQUAL(tile.x, 8);
+    BOOST_CHECK_EQUAL(tile.y, 4);
+    BOOST_CHECK_EQUAL(tile.width, 4);
+    BOOST_CHECK_EQUAL(tile.height, 4);
+    BOOST_REQUIRE_EQUAL(tile.imageData.size(), 4 * 4 * 4);
+
+    const char* dataOut = tile.imageData.constData();
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.data(), data.data() + 4 * 4 * 4,
+                                  dataOut, dataOut + 4 * 4 * 4);
+}
+
+BOOST_AUTO_TEST_CASE(testScaledTilesOfSizeNotMultipleOfScaleDoNotOverlap)
+{
+    // Three adjacent tiles of 20x12 pixels decoded at scale 8
+    std::vector<char> data;
+    for (size_t i = 0; i < 20 * 12; ++i)
+        data.insert(data.end(), {92, 28, 0, -1});
+    deflect::ImageWrapper imageWrapper(data.data(), 20, 12, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+    deflect::ImageJpegCompressor compressor;
+    const auto jpeg = compressor.computeJpeg(imageWrapper, QRect(0, 0, 20, 12));
+
+    deflect::server::TileDecoder decoder;
+    decoder.setScale(8);
+
+    std::vector<deflect::server::Tile> tiles(3);
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        tiles[i].x = i * 20;
+        tiles[i].y = 12;
+        tiles[i].width = 20;
+        tiles[i].height = 12;
+        tiles[i].imageData = jpeg;
+    }
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+    auto yuvTile = tiles[1];
+    BOOST_CHECK_THROW(decoder.decodeToYUV(yuvTile), std::runtime_error);
+#endif
+    for (auto& tile : tiles)
+        decoder.decode(tile);
+
+    // 60x24 pixels at scale 8 give 8x3 pixels: tiles of 3, 2 and 3 columns
+    const unsigned int expectedX[] = {0, 3, 5};
+    const unsigned int expectedWidth[] = {3, 2, 3};
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        const auto& tile = tiles[i];
+        BOOST_CHECK_EQUAL(tile.format, deflect::Format::rgba);
+        BOOST_CHECK_EQUAL(tile.x, expectedX[i]);
+        BOOST_CHECK_EQUAL(tile.y, 2);
+        BOOST_CHECK_EQUAL(tile.width, expectedWidth[i]);
+        BOOST_CHECK_EQUAL(tile.height, 1);
+        BOOST_REQUIRE_EQUAL(tile.imageData.size(), int(tile.width * 4));
+
+        const char* dataOut = tile.imageData.constData();
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.data(), data.data() + tile.width * 4,
+                                      dataOut, dataOut + tile.width * 4);
+    }
+    BOOST_CHECK_EQUAL(tiles[2].x + tiles[2].width, 8);
+}
+
+BOOST_AUTO_TEST_CASE(testComputeDecodingScale)
+{
+    using deflect::server::TileDecoder;
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {3840, 2160}),
+                      1);
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {1920, 1080}),
+                      2);
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {1000, 500}), 2);
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {960, 540}), 4);
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {200, 100}), 8);
+    BOOST_CHECK_EQUAL(TileDecoder::computeScale({3840, 2160}, {4000, 100}),
+                      1);
+}
+
 BOOST_AUTO_TEST_CASE(testDecompressionOfInvalidData)
 {
     const QByteArray invalidJpegData{"notjpeg923%^#8"};
@@ -300,3 +477,47 @@ BOOST_AUTO_TEST_CASE(testDecompressionOfInvalidData)
     BOOST_CHECK_NO_THROW(decoder.startDecoding(tile));
     BOOST_CHECK_THROW(decoder.waitDecoding(), std::runtime_error);
 }
+
+BOOST_AUTO_TEST_CASE(testParallelDecodingOfFrame)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    deflect::server::Frame frame;
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        deflect::server::Tile tile;
+        tile.x = (i % 4) * 8;
+        tile.y = (i / 4) * 8;
+        tile.width = 8;
+        tile.height = 8;
+        tile.imageData = jpegData;
+        frame.tiles.push_back(tile);
+    }
+
+    deflect::server::TileDecoder decoder;
+    decoder.decode(frame, 4);
+
+    for (const auto& tile : frame.tiles)
+    {
+        BOOST_REQUIRE_EQUAL(tile.format, deflect::Format::rgba);
+        const char* dataOut = tile.imageData.constData();
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.data(), data.data() + data.size(),
+                                      dataOut, dataOut + data.size());
+    }
+
+    // Invalid tiles are reported, the other ones are still decoded
+    frame.tiles[3].format = deflect::Format::jpeg;
+    frame.tiles[3].imageData = QByteArray{"notjpeg923%^#8"};
+    frame.tiles[5].format = deflect::Format::jpeg;
+    frame.tiles[5].imageData = jpegData;
+
+    BOOST_CHECK_THROW(decoder.decode(frame, 4), std::runtime_error);
+    BOOST_CHECK_EQUAL(frame.tiles[3].format, deflect::Format::jpeg);
+    BOOST_CHECK_EQUAL(frame.tiles[5].format, deflect::Format::rgba);
+}
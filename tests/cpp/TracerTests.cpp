@@ -0,0 +1,87 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE TracerTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/Tracer.h>
+
+#include <QFile>
+
+#include <thread>
+
+namespace
+{
+const char* traceFile = "TracerTests.json";
+const size_t eventCount = 10;
+
+QByteArray _readTraceFile()
+{
+    QFile file(traceFile);
+    BOOST_REQUIRE(file.open(QIODevice::ReadOnly));
+    return file.readAll();
+}
+}
+
+BOOST_AUTO_TEST_CASE(tracingIsEnabledByEnvironmentVariable)
+{
+    qputenv("DEFLECT_TRACE_FILE", traceFile);
+    BOOST_REQUIRE(deflect::Tracer::get());
+    BOOST_CHECK_EQUAL(deflect::Tracer::get(), deflect::Tracer::get());
+}
+
+BOOST_AUTO_TEST_CASE(eventsAreWrittenWhenThreadExits)
+{
+    BOOST_REQUIRE(deflect::Tracer::get());
+
+    std::thread thread{[] {
+        for (size_t i = 0; i < eventCount; ++i)
+            const deflect::TraceScope trace{"test", "threadEvent"};
+    }};
+    thread.join();
+
+    const auto content = _readTraceFile();
+    BOOST_CHECK(content.startsWith("["));
+    BOOST_CHECK_EQUAL(content.count("\"name\":\"threadEvent\""),
+                      int(eventCount));
+    BOOST_CHECK_EQUAL(content.count("\"cat\":\"test\""), int(eventCount));
+    BOOST_CHECK_EQUAL(content.count("\"ph\":\"X\""), int(eventCount));
+}
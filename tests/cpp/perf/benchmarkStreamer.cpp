@@ -42,7 +42,6 @@
 #include <deflect/ImageSegmenter.h>
 #include <deflect/Segment.h>
 #include <deflect/Stream.h>
-#include <deflect/StreamPrivate.h>
 
 #include <iostream>
 #include <memory>
@@ -144,10 +143,6 @@ struct BenchmarkOptions
     unsigned int quality;
 };
 
-namespace deflect
-{
-namespace test
-{
 /**
  * Stream image segments for benchmarking purposes.
  */
@@ -254,14 +249,14 @@ public:
 
     bool sendPrecompressedJpeg()
     {
-        for (deflect::Segments::const_iterator it = _jpegSegments.begin();
-             it != _jpegSegments.end(); ++it)
-        {
-            if (!_stream->_impl->sendWorker._sendSegment(*it))
-                return false;
-        }
-
-        return _stream->finishFrame().get();
+        std::vector<deflect::Stream::Future> sends;
+        for (const auto& segment : _jpegSegments)
+            sends.push_back(_stream->sendSegment(segment));
+
+        bool success = _stream->finishFrame().get();
+        for (auto& send : sends)
+            success = send.get() && success;
+        return success;
     }
 
 private:
@@ -270,8 +265,6 @@ private:
     std::unique_ptr<deflect::Stream> _stream;
     deflect::Segments _jpegSegments;
 };
-}
-}
 
 int main(int argc, char** argv)
 {
@@ -283,7 +276,7 @@ int main(int argc, char** argv)
         return 0;
     }
 
-    deflect::test::Application benchmarkStreamer(options);
+    Application benchmarkStreamer(options);
 
     Timer timer;
     timer.start();
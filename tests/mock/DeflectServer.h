@@ -59,6 +59,15 @@ public:
 
     quint16 serverPort() const { return _server->getPort(); }
     void requestFrame(QString uri) { _server->requestFrame(uri); }
+    void closePixelStream(QString uri) { _server->closePixelStream(uri); }
+    void setTileDecoding(const deflect::server::TileDecoding mode)
+    {
+        _server->setTileDecoding(mode);
+    }
+    deflect::server::Statistics getStatistics()
+    {
+        return _server->getStatistics();
+    }
     void waitForMessage();
 
     size_t getReceivedFrames() const { return _receivedFrames; }